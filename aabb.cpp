@@ -9,5 +9,17 @@ aabb surrounding(aabb box0, aabb box1) {
         std::fmax(box0._max.y(), box1._max.y()),
         std::fmax(box0._max.z(), box1._max.z()));
         
+    return aabb(small, big);
+}
+
+aabb surrounding(aabb box, const vec3 &p) {
+    vec3 small(std::fmin(box._min.x(), p.x()),
+        std::fmin(box._min.y(), p.y()),
+        std::fmin(box._min.z(), p.z()));
+        
+    vec3 big(std::fmax(box._max.x(), p.x()),
+        std::fmax(box._max.y(), p.y()),
+        std::fmax(box._max.z(), p.z()));
+        
     return aabb(small, big);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define __AABB_H__
 
 #include <cmath>
+#include <float.h>
 
 #include "vec3.h"
 #include "ray.h"
@@ -36,10 +37,46 @@ class aabb {
             return true;
         }
         
+        // Same slab test, with the reciprocal of the ray direction computed once by the caller.
+        bool hit(const ray &r, const vec3 &inv_dir, float tmin, float tmax) const
+        {
+            for(int a = 0; a < 3; ++a) {
+                float t0 = (_min[a] - r.origin()[a]) * inv_dir[a];
+                float t1 = (_max[a] - r.origin()[a]) * inv_dir[a];
+                
+                if(inv_dir[a] < 0.0f)
+                    std::swap(t0, t1);
+                    
+                tmin = (t0 > tmin) ? t0 : tmin;
+                tmax = (t1 < tmax) ? t1 : tmax;
+                
+                if(tmax <= tmin)
+                    return false;
+            }
+            return true;
+        }
+        
+        float surface_area() const
+        {
+            vec3 d = _max - _min;
+            
+            if(d.x() < 0.0 || d.y() < 0.0 || d.z() < 0.0)
+                return 0.0;
+                
+            return 2.0 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+        }
+        
         vec3 _min;
         vec3 _max;
 };
 
+// Inverted box, the identity for surrounding().
+inline aabb empty_box()
+{
+    return aabb(vec3(FLT_MAX, FLT_MAX, FLT_MAX), vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+}
+
 aabb surrounding(aabb box0, aabb box1);
+aabb surrounding(aabb box, const vec3 &p);
 
 #endif // __AABB_H__
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "alias_table.h"
+
+alias_table::alias_table(const float *weights, int n) : threshold(n), probability(n), alias(n)
+{
+    for(int i = 0; i < n; ++i) {
+        if( weights[i] > 0.0f )
+            total += weights[i];
+    }
+
+    // Scaled so the average slot is 1, below it a slot needs an alias.
+    std::vector<double> scaled(n);
+    std::vector<int> small, large;
+
+    for(int i = 0; i < n; ++i) {
+        double w = total > 0.0 ? (weights[i] > 0.0f ? weights[i] : 0.0) / total : 1.0 / n;
+
+        probability[i] = float(w);
+        scaled[i] = w * n;
+        alias[i] = i;
+
+        if( scaled[i] < 1.0 )
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+
+    while( !small.empty() && !large.empty() ) {
+        int s = small.back(), l = large.back();
+        small.pop_back();
+
+        threshold[s] = float(scaled[s]);
+        alias[s] = l;
+
+        scaled[l] -= 1.0 - scaled[s];
+        if( scaled[l] < 1.0 ) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // What is left is 1 up to rounding.
+    for(int i : small)
+        threshold[i] = 1.0f;
+    for(int i : large)
+        threshold[i] = 1.0f;
+}
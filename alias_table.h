@@ -0,0 +1,45 @@
+#ifndef __ALIAS_TABLE_H__
+#define __ALIAS_TABLE_H__
+
+#include <vector>
+
+// Walker's alias method: picks index i with probability proportional to its
+// weight in constant time from one random number. Each slot keeps the share
+// of its own index and the index filling the rest of it, built in linear
+// time with Vose's two worklists.
+class alias_table
+{
+    public:
+        alias_table() {}
+
+        // Negative weights count as zero, all zero makes every index as likely.
+        alias_table(const float *weights, int n);
+
+        // u in [0, 1).
+        int sample(float u) const
+        {
+            float x = u * float(alias.size());
+            int i = int(x);
+
+            if( i >= int(alias.size()) )
+                i = int(alias.size()) - 1;
+
+            return x - float(i) < threshold[i] ? i : alias[i];
+        }
+
+        float pmf(int i) const { return probability[i]; }
+        int size() const { return int(alias.size()); }
+
+        // Of the table, for memory accounting.
+        long long bytes() const
+        {
+            return (long long)alias.capacity() * sizeof(int) + (long long)(threshold.capacity() + probability.capacity()) * sizeof(float);
+        }
+
+        std::vector<float>  threshold,      // Share of slot i left to i itself.
+                            probability;    // Of index i.
+        std::vector<int>    alias;
+        double              total = 0.0;    // Of the weights.
+};
+
+#endif // __ALIAS_TABLE_H__
@@ -0,0 +1,511 @@
+#include "bdpt.h"
+#include "render.h"
+#include "materials.h"
+#include "light_tree.h"
+#include "memory_stats.h"
+#include "stats.h"
+#include "rangen.h"
+
+#include <float.h>
+#include <algorithm>
+
+const int kBdptCameraVertices = kMaxDepth + 2;
+const int kBdptLightVertices = kMaxDepth + 1;
+const int kRouletteVertices = 3;    // A subpath gets this many before Russian roulette can end it.
+
+//
+// SPLATS
+//
+
+splat_buffer::splat_buffer(int n) : pixels(n), values(new std::atomic<float>[3 * n])
+{
+    for(int i = 0; i < 3 * n; ++i)
+        values[i].store(0.0f, std::memory_order_relaxed);
+
+    account_memory(memory_scratch, 3LL * n * sizeof(std::atomic<float>), 1);
+}
+
+splat_buffer::~splat_buffer()
+{
+    account_memory(memory_scratch, -3LL * pixels * sizeof(std::atomic<float>), -1);
+}
+
+void splat_buffer::add(int pixel, const vec3 &c)
+{
+    for(int k = 0; k < 3; ++k) {
+        std::atomic<float> &value = values[3 * pixel + k];
+        float old = value.load(std::memory_order_relaxed);
+
+        // A failed exchange reloads old, the loop retries with the new sum.
+        while( !value.compare_exchange_weak(old, old + c[k], std::memory_order_relaxed) )
+            ;
+    }
+}
+
+vec3 splat_buffer::get(int pixel) const
+{
+    return vec3(values[3 * pixel].load(std::memory_order_relaxed),
+                values[3 * pixel + 1].load(std::memory_order_relaxed),
+                values[3 * pixel + 2].load(std::memory_order_relaxed));
+}
+
+//
+// CONTEXT
+//
+
+bdpt_context::bdpt_context(const scene &s) : the_scene(s), splats(s.nx * s.ny)
+{
+    if( light_tree *tree = dynamic_cast<light_tree *>(s.lights) )
+        lights = tree->lights;
+    else if( hitable_list *list = dynamic_cast<hitable_list *>(s.lights) )
+        lights.assign(list->list, list->list + list->list_size);
+    else if( s.lights )
+        lights.push_back(s.lights);
+
+    std::vector<float> powers(lights.size(), 0.0f);
+    areas.assign(lights.size(), 0.0f);
+
+    for(size_t i = 0; i < lights.size(); ++i) {
+        hit_record rec;
+
+        if( lights[i]->random_point(rec, areas[i]) && rec.mat_ptr )
+            powers[i] = lights[i]->power();
+        else
+            areas[i] = 0.0;
+    }
+
+    if( !lights.empty() )
+        by_power = alias_table(powers.data(), int(lights.size()));
+
+    const camera &cam = *s.cam;
+    focus_distance = dot(cam.origin - cam.lower_left_corner, cam.w);
+    film_area = cam.horizontal.length() * cam.vertical.length() / (focus_distance * focus_distance);
+}
+
+// Only paths that end on an emitter ask, a search over the lights is enough.
+int bdpt_context::light_at(const ray &r, float t) const
+{
+    hit_record rec;
+
+    for(size_t i = 0; i < lights.size(); ++i) {
+        if( lights[i]->hit(r, t * 0.999f, t * 1.001f + 1e-4f, rec) )
+            return int(i);
+    }
+
+    return -1;
+}
+
+//
+// VERTICES
+//
+
+enum bdpt_vertex_kind
+{
+    vertex_camera,
+    vertex_light,       // Where a light path starts, on an emitter.
+    vertex_surface,
+    vertex_medium       // Scattered inside a constant_medium, it has no normal.
+};
+
+struct bdpt_vertex
+{
+    bdpt_vertex_kind    kind;
+    hit_record          rec;        // Only p for the camera.
+    ray                 r_in;       // Surfaces and media, the ray that found them.
+    vec3                beta;       // Path throughput up to the vertex over the pdfs.
+    float               pdf_fwd,    // Per unit area, of its own subpath finding the vertex.
+                        pdf_rev;    // Of the other subpath finding it, coming from the far end.
+    bool                delta;      // A mirror or glass bounce, it can not be joined.
+    int                 light;      // The light it is on, -1 for none.
+};
+
+static bool is_black(const vec3 &c)
+{
+    return c.x() <= 0.0 && c.y() <= 0.0 && c.z() <= 0.0;
+}
+
+// Per unit area at next, of a direction toward it picked at from with
+// density pdf per unit solid angle.
+static float to_area(float pdf, const bdpt_vertex &from, const bdpt_vertex &next)
+{
+    vec3 d = next.rec.p - from.rec.p;
+    float distance_squared = d.squared_length();
+
+    if( distance_squared <= 0.0 )
+        return 0.0;
+
+    if( next.kind == vertex_surface || next.kind == vertex_light )
+        pdf *= fabs(dot(next.rec.normal, d)) / sqrt(distance_squared);
+
+    return pdf / distance_squared;
+}
+
+// Per unit solid angle, camera rays are spread evenly over the film.
+static float camera_pdf(const bdpt_context &c, const vec3 &direction)
+{
+    float cosine = -dot(unit_vector(direction), c.the_scene.cam->w);
+
+    return cosine > 0.0 ? 1.0 / (c.film_area * cosine * cosine * cosine) : 0.0;
+}
+
+// Light paths leave either face of the light, cosine weighted.
+static float emission_pdf(const bdpt_vertex &light, const vec3 &direction)
+{
+    return fabs(dot(light.rec.normal, unit_vector(direction))) / (2.0 * kPI);
+}
+
+// Per unit area, of a light path starting at v.
+static float light_origin_pdf(const bdpt_context &c, const bdpt_vertex &v)
+{
+    if( v.light < 0 || c.areas[v.light] <= 0.0 )
+        return 0.0;
+
+    return c.by_power.pmf(v.light) / c.areas[v.light];
+}
+
+// Per unit area at next, of cur picking it when reached from prev.
+static float vertex_pdf(const bdpt_context &c, const bdpt_vertex *prev, const bdpt_vertex &cur, const bdpt_vertex &next)
+{
+    vec3 direction = next.rec.p - cur.rec.p;
+    float pdf;
+
+    if( cur.kind == vertex_camera )
+        pdf = camera_pdf(c, direction);
+    else if( cur.kind == vertex_light )
+        pdf = emission_pdf(cur, direction);
+    else
+        pdf = cur.rec.mat_ptr->pdf(ray(prev->rec.p, cur.rec.p - prev->rec.p, cur.r_in.time()), cur.rec, direction);
+
+    return to_area(pdf, cur, next);
+}
+
+// Pixel whose camera rays from lens point l go through p, -1 if p is out of the image.
+static int film_pixel(const bdpt_context &c, const vec3 &l, const vec3 &p)
+{
+    const camera &cam = *c.the_scene.cam;
+    vec3 d = p - l;
+    float along = -dot(d, cam.w);
+
+    if( along <= 0.0 )
+        return -1;
+
+    vec3 on_film = l + d * (c.focus_distance / along) - cam.lower_left_corner;
+    float s = dot(on_film, cam.horizontal) / cam.horizontal.squared_length(),
+          t = dot(on_film, cam.vertical) / cam.vertical.squared_length();
+
+    if( s < 0.0 || s >= 1.0 || t < 0.0 || t >= 1.0 )
+        return -1;
+
+    int i = std::min(int(s * c.the_scene.nx), c.the_scene.nx - 1),
+        j = std::min(int(t * c.the_scene.ny), c.the_scene.ny - 1);
+
+    return j * c.the_scene.nx + i;
+}
+
+//
+// SUBPATHS
+//
+
+// Extends a subpath from its last vertex along r, picked with density pdf
+// per unit solid angle, until it is absorbed, leaves the scene or has max
+// vertices. Returns how many it has. escaped is null for light paths, camera
+// paths add to it what the rays that leave see, and their ends are counted
+// in the path stats like color() does, by the rays they traced.
+static int random_walk(const bdpt_context &c, ray r, vec3 beta, float pdf, bdpt_vertex *path, int count, int max,
+                       vec3 *escaped, uint64_t &traced)
+{
+    const scene &the_scene = c.the_scene;
+
+    while( count < max ) {
+        bdpt_vertex &prev = path[count - 1],
+                    &v = path[count];
+
+        ++traced;
+        RT_STAT(rays[prev.kind == vertex_camera ? stat_ray_camera : stat_ray_scatter]);
+        if( !the_scene.world->hit(r, 0.001, FLT_MAX, v.rec) ) {
+            if( escaped ) {
+                RT_STAT_PATH(count, stat_end_miss);
+                if( the_scene.environment )
+                    *escaped += beta * the_scene.environment->radiance(r.direction());
+            }
+            break;
+        }
+
+        v.kind = v.rec.mat_ptr->kind == material_isotropic ? vertex_medium : vertex_surface;
+        v.r_in = r;
+        v.beta = beta;
+        v.pdf_fwd = to_area(pdf, prev, v);
+        v.pdf_rev = 0.0;
+        v.delta = false;
+        v.light = -1;
+        ++count;
+
+        if( escaped && !is_black(v.rec.mat_ptr->emitted(v.rec.u, v.rec.v, v.rec.p)) )
+            v.light = c.light_at(r, v.rec.t);
+
+        bsdf_sample s;
+
+        if( count == max || !(RT_STAT(scatter_calls[v.rec.mat_ptr->kind]), v.rec.mat_ptr->sample(r, v.rec, s)) ) {
+            if( escaped )
+                RT_STAT_PATH(count - 1, count < max ? stat_end_absorbed : stat_end_max_depth);
+            break;
+        }
+
+        vec3 weight = s.weight();
+
+        // Past the first bounces the path goes on with the odds the bounce keeps.
+        if( count > kRouletteVertices ) {
+            float keep = std::min(1.0f, std::max(weight.x(), std::max(weight.y(), weight.z())));
+
+            if( drand48() >= keep ) {
+                if( escaped )
+                    RT_STAT_PATH(count - 1, stat_end_roulette);
+                break;
+            }
+            weight /= keep;
+        }
+
+        beta *= weight;
+
+        if( s.pdf > 0.0 ) {
+            float reverse = v.rec.mat_ptr->pdf(ray(v.rec.p + s.direction, -s.direction, r.time()), v.rec, -r.direction());
+            prev.pdf_rev = to_area(reverse, v, prev);
+            pdf = s.pdf;
+        }
+        else {
+            v.delta = true;
+            prev.pdf_rev = 0.0;
+            pdf = 0.0;
+        }
+
+        r = ray(v.rec.p, s.direction, r.time());
+    }
+
+    return count;
+}
+
+// A point on a light picked by power and a direction off it, then on from there.
+static int light_walk(const bdpt_context &c, float time, bdpt_vertex *path, uint64_t &traced)
+{
+    if( c.lights.empty() )
+        return 0;
+
+    bdpt_vertex &l = path[0];
+    int i = c.by_power.sample(drand48());
+    float area;
+
+    if( c.areas[i] <= 0.0 || c.by_power.pmf(i) <= 0.0 || !c.lights[i]->random_point(l.rec, area) )
+        return 0;
+
+    l.kind = vertex_light;
+    l.light = i;
+    l.delta = false;
+    l.pdf_fwd = c.by_power.pmf(i) / area;
+    l.pdf_rev = 0.0;
+    l.beta = l.rec.mat_ptr->emitted(l.rec.u, l.rec.v, l.rec.p) / l.pdf_fwd;
+
+    vec3 n = drand48() < 0.5 ? l.rec.normal : -l.rec.normal;
+    vec3 direction = onb(n).local(random_cosine_direction());
+    float pdf = emission_pdf(l, direction);
+
+    if( pdf <= 0.0 || is_black(l.beta) )
+        return 1;
+
+    return random_walk(c, ray(l.rec.p, direction, time), l.beta * fabs(dot(n, direction)) / pdf, pdf,
+                       path, 1, kBdptLightVertices, nullptr, traced);
+}
+
+//
+// STRATEGIES
+//
+
+static float remap0(float pdf)
+{
+    return pdf != 0.0 ? pdf : 1.0;
+}
+
+// Power heuristic over the strategies that make the same path with other s
+// and t. Each moves the joint one vertex along, trading the pdf its own
+// subpath found that vertex with for the one the other would have. Delta
+// vertices can not be joined, the strategies joining at them do not count.
+static float mis_weight(const bdpt_context &c, const bdpt_vertex *light_path, int s, const bdpt_vertex *camera_path, int t,
+                        const bdpt_vertex *lens)
+{
+    float camera_fwd[kBdptCameraVertices], camera_rev[kBdptCameraVertices],
+          light_fwd[kBdptLightVertices], light_rev[kBdptLightVertices];
+    bool camera_delta[kBdptCameraVertices], light_delta[kBdptLightVertices];
+
+    for(int i = 0; i < t; ++i) {
+        camera_fwd[i] = camera_path[i].pdf_fwd;
+        camera_rev[i] = camera_path[i].pdf_rev;
+        camera_delta[i] = camera_path[i].delta;
+    }
+    for(int i = 0; i < s; ++i) {
+        light_fwd[i] = light_path[i].pdf_fwd;
+        light_rev[i] = light_path[i].pdf_rev;
+        light_delta[i] = light_path[i].delta;
+    }
+
+    const bdpt_vertex &pt = t == 1 ? *lens : camera_path[t - 1];
+    const bdpt_vertex *qs = s > 0 ? &light_path[s - 1] : nullptr,
+                      *pt_minus = t > 1 ? &camera_path[t - 2] : nullptr,
+                      *qs_minus = s > 1 ? &light_path[s - 2] : nullptr;
+
+    camera_delta[t - 1] = false;
+
+    if( s == 0 ) {
+        // pt is on a light, found by chance. No light path starts on emitters that are not listed as lights.
+        camera_rev[t - 1] = light_origin_pdf(c, pt);
+        if( camera_rev[t - 1] <= 0.0 )
+            return 1.0;
+        camera_rev[t - 2] = to_area(emission_pdf(pt, pt_minus->rec.p - pt.rec.p), pt, *pt_minus);
+    }
+    else {
+        light_delta[s - 1] = false;
+        camera_rev[t - 1] = vertex_pdf(c, qs_minus, *qs, pt);
+        if( pt_minus )
+            camera_rev[t - 2] = vertex_pdf(c, qs, pt, *pt_minus);
+        light_rev[s - 1] = vertex_pdf(c, pt_minus, pt, *qs);
+        if( qs_minus )
+            light_rev[s - 2] = vertex_pdf(c, &pt, *qs, *qs_minus);
+    }
+
+    float sum = 0.0, ratio = 1.0;
+
+    for(int i = t - 1; i > 0; --i) {
+        float r = remap0(camera_rev[i]) / remap0(camera_fwd[i]);
+        ratio *= r * r;
+        if( !camera_delta[i] && !camera_delta[i - 1] )
+            sum += ratio;
+    }
+
+    ratio = 1.0;
+    for(int i = s - 1; i >= 0; --i) {
+        float r = remap0(light_rev[i]) / remap0(light_fwd[i]);
+        ratio *= r * r;
+        if( !light_delta[i] && (i == 0 || !light_delta[i - 1]) )
+            sum += ratio;
+    }
+
+    return 1.0 / (1.0 + sum);
+}
+
+// The radiance the path made of the first s light path vertices and the
+// first t camera path ones carries, MIS weighted. With t == 1 the light path
+// is seen from a new point of the lens, pixel is where it lands.
+static vec3 connect(const bdpt_context &c, const bdpt_vertex *light_path, int s, const bdpt_vertex *camera_path, int t,
+                    float time, int &pixel, uint64_t &traced)
+{
+    const scene &the_scene = c.the_scene;
+    vec3 radiance;
+    bdpt_vertex lens;
+
+    if( s == 0 ) {
+        const bdpt_vertex &pt = camera_path[t - 1];
+
+        if( pt.kind != vertex_surface )
+            return vec3(0.0, 0.0, 0.0);
+
+        radiance = pt.beta * pt.rec.mat_ptr->emitted(pt.rec.u, pt.rec.v, pt.rec.p);
+        if( is_black(radiance) )
+            return radiance;
+
+        return radiance * mis_weight(c, light_path, s, camera_path, t, nullptr);
+    }
+
+    const bdpt_vertex &qs = light_path[s - 1];
+    vec3 from, to;
+
+    if( qs.delta )
+        return vec3(0.0, 0.0, 0.0);
+
+    if( t == 1 ) {
+        const camera &cam = *the_scene.cam;
+        vec3 rd = cam.lens_radius * random_in_unit_disk();
+
+        lens.kind = vertex_camera;
+        lens.rec.p = cam.origin + cam.u * rd.x() + cam.v * rd.y();
+        lens.beta = vec3(1.0, 1.0, 1.0);
+        lens.pdf_fwd = lens.pdf_rev = 0.0;
+        lens.delta = false;
+        lens.light = -1;
+
+        pixel = film_pixel(c, lens.rec.p, qs.rec.p);
+        if( pixel < 0 )
+            return vec3(0.0, 0.0, 0.0);
+
+        vec3 d = lens.rec.p - qs.rec.p;
+        float distance_squared = d.squared_length();
+        vec3 direction = d / sqrt(distance_squared);
+        float cosine = dot(direction, cam.w);
+        vec3 f = qs.kind == vertex_light ? vec3(1.0, 1.0, 1.0) * fabs(dot(qs.rec.normal, direction)) : qs.rec.mat_ptr->eval(qs.r_in, qs.rec, direction);
+
+        // What the pixel sees, per unit area at qs: the film is uniform in
+        // the plane at distance 1, 1 / (film_area cos^3) per unit solid angle.
+        radiance = qs.beta * f / (c.film_area * cosine * cosine * cosine * distance_squared);
+        from = qs.rec.p;
+        to = lens.rec.p;
+    }
+    else {
+        const bdpt_vertex &pt = camera_path[t - 1];
+
+        if( pt.delta )
+            return vec3(0.0, 0.0, 0.0);
+
+        vec3 d = qs.rec.p - pt.rec.p;
+        float distance_squared = d.squared_length();
+        vec3 direction = d / sqrt(distance_squared);
+        vec3 f_qs = qs.kind == vertex_light ? vec3(1.0, 1.0, 1.0) * fabs(dot(qs.rec.normal, direction)) : qs.rec.mat_ptr->eval(qs.r_in, qs.rec, -direction);
+
+        radiance = pt.beta * pt.rec.mat_ptr->eval(pt.r_in, pt.rec, direction) * f_qs * qs.beta / distance_squared;
+        from = pt.rec.p;
+        to = qs.rec.p;
+    }
+
+    if( is_black(radiance) )
+        return radiance;
+
+    vec3 d = to - from;
+    float distance = d.length();
+
+    ++traced;
+    RT_STAT(rays[stat_ray_shadow]);
+    if( the_scene.world->occluded(ray(from, d / distance, time), 0.001, distance - 0.001) )
+        return vec3(0.0, 0.0, 0.0);
+
+    return radiance * mis_weight(c, light_path, s, camera_path, t, &lens);
+}
+
+vec3 color_bdpt(const ray &r, const bdpt_context &c, uint64_t &rays)
+{
+    bdpt_vertex camera_path[kBdptCameraVertices],
+                light_path[kBdptLightVertices];
+    vec3 radiance(0.0, 0.0, 0.0);
+
+    camera_path[0].kind = vertex_camera;
+    camera_path[0].rec.p = r.origin();
+    camera_path[0].beta = vec3(1.0, 1.0, 1.0);
+    camera_path[0].pdf_fwd = camera_path[0].pdf_rev = 0.0;
+    camera_path[0].delta = false;
+    camera_path[0].light = -1;
+
+    int camera_count = random_walk(c, r, vec3(1.0, 1.0, 1.0), camera_pdf(c, r.direction()), camera_path, 1, kBdptCameraVertices, &radiance, rays);
+    int light_count = light_walk(c, r.time(), light_path, rays);
+
+    for(int t = 1; t <= camera_count; ++t) {
+        for(int s = 0; s <= light_count; ++s) {
+            if( s + t < 2 || s + t - 2 > kMaxDepth )
+                continue;
+
+            int pixel = -1;
+            vec3 contribution = connect(c, light_path, s, camera_path, t, r.time(), pixel, rays);
+
+            if( t > 1 )
+                radiance += contribution;
+            else if( pixel >= 0 && !is_black(contribution) )
+                c.splats.add(pixel, contribution);
+        }
+    }
+
+    return radiance;
+}
@@ -0,0 +1,54 @@
+#ifndef __BDPT_H__
+#define __BDPT_H__
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include "scene.h"
+#include "alias_table.h"
+
+// Light tracing adds to whatever pixel a light path is seen from, from any
+// thread. Channels are atomic floats added to with compare and swap, so
+// splatting never takes a lock.
+class splat_buffer
+{
+    public:
+        splat_buffer(int n);
+        ~splat_buffer();
+
+        void add(int pixel, const vec3 &c);
+        vec3 get(int pixel) const;
+
+        int                                     pixels;
+        std::unique_ptr<std::atomic<float>[]>   values;
+};
+
+// What bidirectional path tracing needs besides the scene, set up once per
+// render: the emitters light paths start from, picked by power, the film of
+// the camera and the splats of light tracing.
+struct bdpt_context
+{
+    bdpt_context(const scene &s);
+
+    // Of the light, among lights, that r hits at t. -1 if it is none of them.
+    int light_at(const ray &r, float t) const;
+
+    const scene             &the_scene;
+    std::vector<hitable *>  lights;
+    std::vector<float>      areas;          // Of every light, 0 for those that can not start light paths.
+    alias_table             by_power;
+    float                   film_area,      // Of the image plane at distance 1 from the lens.
+                            focus_distance;
+    mutable splat_buffer    splats;         // Radiance, to be divided by the samples per pixel.
+};
+
+// Radiance along the camera ray r by bidirectional path tracing: a camera
+// path from r and a light path are joined at every pair of their vertices,
+// each joint weighted against the other ways of making the same path with
+// the power heuristic. The joints to the camera land on other pixels, they
+// go to the splats. rays counts what is traced.
+vec3 color_bdpt(const ray &r, const bdpt_context &context, uint64_t &rays);
+
+#endif // __BDPT_H__
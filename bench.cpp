@@ -0,0 +1,253 @@
+#include "bench.h"
+#include "hitables.h"
+#include "instances.h"
+#include "bvh_node.h"
+#include "materials.h"
+#include "textures.h"
+#include "perlin.h"
+#include "camera.h"
+#include "rangen.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const int kBenchInputs = 1024;      // Inputs cycled through, a power of two.
+const unsigned int kBenchSeed = 2017;
+
+static const char *bench_filter;
+static double bench_seconds;
+static int bench_matched;
+
+// Folded into by every benchmark, so the compiler can not drop the work.
+static volatile float bench_sink;
+
+static vec3 random_vec3(float lo, float hi)
+{
+    return vec3(lo + (hi - lo) * drand48(), lo + (hi - lo) * drand48(), lo + (hi - lo) * drand48());
+}
+
+// From points around the origin toward points near it, so roughly half of
+// them hit a unit sized object there.
+static std::vector<ray> random_rays(float distance, float spread)
+{
+    std::vector<ray> rays;
+
+    for(int i = 0; i < kBenchInputs; ++i) {
+        vec3 from = distance * unit_vector(random_vec3(-1.0, 1.0));
+        vec3 to = random_vec3(-spread, spread);
+        rays.push_back(ray(from, to - from, drand48()));
+    }
+
+    return rays;
+}
+
+template<typename F>
+static double time_batch(F &op, long long batch)
+{
+    float sum = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+
+    for(long long i = 0; i < batch; ++i)
+        sum += op(int(i & (kBenchInputs - 1)));
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bench_sink = bench_sink + sum;
+
+    return seconds;
+}
+
+// op(i) does the operation once on input i and returns something that
+// depends on the result.
+template<typename F>
+static void bench(const char *name, F op)
+{
+    if( bench_filter && !strstr(name, bench_filter) )
+        return;
+
+    ++bench_matched;
+
+    // Warm up caches and branch predictors while growing the batch to about
+    // a hundredth of the time budget.
+    long long batch = 64;
+    while( time_batch(op, batch) < bench_seconds / 100.0 && batch < (1ll << 40) )
+        batch *= 2;
+
+    std::vector<double> ns;
+    double total = 0.0;
+
+    while( total < bench_seconds || ns.size() < 5 ) {
+        double t = time_batch(op, batch);
+        total += t;
+        ns.push_back(t * 1e9 / double(batch));
+    }
+
+    std::sort(ns.begin(), ns.end());
+    double median = ns[ns.size() / 2];
+
+    std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << median << " ns/op" << std::setw(10) << ns.front() << " min"
+              << std::setw(14) << std::setprecision(0) << 1e9 / median << " ops/s\n";
+}
+
+//
+// BENCHMARKS
+//
+
+static void bench_hitable(const char *name, const hitable &h, const std::vector<ray> &rays)
+{
+    bench(name, [&](int i) {
+        hit_record rec;
+        return h.hit(rays[i], 0.001f, FLT_MAX, rec) ? rec.t : 0.0f;
+    });
+}
+
+// Random spheres filling a cube, with rays starting inside it.
+static void bench_bvh(const char *name, int spheres)
+{
+    if( bench_filter && !strstr(name, bench_filter) )
+        return;
+
+    seed_drand48(kBenchSeed);
+
+    material *mat = new lambertian(new constant_texture(vec3(0.5, 0.5, 0.5)));
+    hitable **list = new hitable*[spheres];
+    float side = std::cbrt(float(spheres));
+
+    for(int i = 0; i < spheres; ++i)
+        list[i] = new sphere(random_vec3(0.0, side), 0.1 + 0.2 * drand48(), mat);
+
+    bvh_node tree(list, spheres, 0.0, 1.0);
+
+    std::vector<ray> rays;
+    for(int i = 0; i < kBenchInputs; ++i)
+        rays.push_back(ray(random_vec3(0.0, side), random_vec3(-1.0, 1.0), 0.0));
+
+    bench_hitable(name, tree, rays);
+
+    std::string occluded = std::string(name) + " occluded";
+    bench(occluded.c_str(), [&](int i) {
+        return tree.occluded(rays[i], 0.001f, FLT_MAX) ? 1.0f : 0.0f;
+    });
+}
+
+bool run_benchmarks(const char *filter, double seconds)
+{
+    bench_filter = filter;
+    bench_seconds = seconds;
+    bench_matched = 0;
+
+    seed_drand48(kBenchSeed);
+
+    material *mat = new lambertian(new constant_texture(vec3(0.5, 0.5, 0.5)));
+    std::vector<ray> rays = random_rays(3.0, 1.0);
+
+    aabb unit_box(vec3(-0.5, -0.5, -0.5), vec3(0.5, 0.5, 0.5));
+    bench("aabb::hit", [&](int i) {
+        return unit_box.hit(rays[i], 0.001f, FLT_MAX) ? 1.0f : 0.0f;
+    });
+
+    std::vector<vec3> inv_dirs;
+    for(const ray &r : rays)
+        inv_dirs.push_back(vec3(1.0 / r.direction().x(), 1.0 / r.direction().y(), 1.0 / r.direction().z()));
+    bench("aabb::hit inv_dir", [&](int i) {
+        return unit_box.hit(rays[i], inv_dirs[i], 0.001f, FLT_MAX) ? 1.0f : 0.0f;
+    });
+
+    sphere ball(vec3(0.0, 0.0, 0.0), 0.5, mat);
+    bench_hitable("sphere::hit", ball, rays);
+    bench("sphere::occluded", [&](int i) {
+        return ball.occluded(rays[i], 0.001f, FLT_MAX) ? 1.0f : 0.0f;
+    });
+
+    moving_sphere moving(vec3(-0.25, 0.0, 0.0), vec3(0.25, 0.0, 0.0), 0.0, 1.0, 0.5, mat);
+    bench_hitable("moving_sphere::hit", moving, rays);
+
+    rect_xy xy(-0.5, 0.5, -0.5, 0.5, 0.0, mat);
+    rect_xz xz(-0.5, 0.5, -0.5, 0.5, 0.0, mat);
+    rect_yz yz(-0.5, 0.5, -0.5, 0.5, 0.0, mat);
+    bench_hitable("rect_xy::hit", xy, rays);
+    bench_hitable("rect_xz::hit", xz, rays);
+    bench_hitable("rect_yz::hit", yz, rays);
+
+    box cube(vec3(-0.5, -0.5, -0.5), vec3(0.5, 0.5, 0.5), mat);
+    bench_hitable("box::hit", cube, rays);
+
+    rotate_y rotated(new box(vec3(-0.5, -0.5, -0.5), vec3(0.5, 0.5, 0.5), mat), 15.0);
+    bench_hitable("rotate_y::hit", rotated, rays);
+
+    bench_bvh("bvh_node::hit 64", 64);
+    bench_bvh("bvh_node::hit 4096", 4096);
+    bench_bvh("bvh_node::hit 65536", 65536);
+
+    seed_drand48(kBenchSeed);
+
+    std::vector<vec3> points;
+    for(int i = 0; i < kBenchInputs; ++i)
+        points.push_back(random_vec3(0.0, 16.0));
+
+    perlin noise;
+    bench("perlin::noise", [&](int i) {
+        return noise.noise(points[i]);
+    });
+    bench("perlin::turb", [&](int i) {
+        return noise.turb(points[i]);
+    });
+
+    // A synthetic texture the size of the earth map, so no file is needed.
+    int tex_nx = 1024, tex_ny = 512;
+    std::vector<unsigned char> pixels(3 * tex_nx * tex_ny);
+    for(unsigned char &c : pixels)
+        c = (unsigned char)(256 * drand48());
+
+    image_texture image(pixels.data(), tex_nx, tex_ny);
+    std::vector<vec3> uvs;
+    for(int i = 0; i < kBenchInputs; ++i)
+        uvs.push_back(random_vec3(0.0, 1.0));
+    bench("image_texture::value", [&](int i) {
+        return image.value(uvs[i].x(), uvs[i].y(), points[i]).x();
+    });
+
+    bench("random_in_unit_sphere", [&](int i) {
+        return random_in_unit_sphere().x();
+    });
+    bench("drand48", [&](int i) {
+        return drand48();
+    });
+
+    camera cam(vec3(278, 278, -800), vec3(278, 278, 0), vec3(0.0, 1.0, 0.0), 40.0, 1.0, 0.1, 10.0, 0.0, 1.0);
+    bench("camera::get_ray", [&](int i) {
+        return cam.get_ray(uvs[i].x(), uvs[i].y()).direction().x();
+    });
+
+    // Hits from both sides of a glass sphere, as refraction and reflection paths see them.
+    dielectric glass(1.5);
+    std::vector<std::pair<ray, hit_record>> glass_hits;
+    for(const ray &r : random_rays(3.0, 0.5)) {
+        hit_record rec;
+        if( ball.hit(r, 0.001, FLT_MAX, rec) ) {
+            rec.mat_ptr = &glass;
+            glass_hits.push_back(std::make_pair(r, rec));
+
+            ray inside(rec.p, r.direction(), r.time());
+            if( ball.hit(inside, 0.001, FLT_MAX, rec) )
+                glass_hits.push_back(std::make_pair(inside, rec));
+        }
+    }
+    for(size_t k = 0; glass_hits.size() < size_t(kBenchInputs); ++k)
+        glass_hits.push_back(glass_hits[k]);
+
+    bench("dielectric::sample", [&](int i) {
+        const std::pair<ray, hit_record> &h = glass_hits[i];
+        bsdf_sample s;
+        glass.sample(h.first, h.second, s);
+        return s.direction.x();
+    });
+
+    return bench_matched > 0;
+}
@@ -0,0 +1,10 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+// Microbenchmarks of the core kernels, so an optimisation can be measured in
+// isolation. Runs every benchmark whose name contains filter, or all of them
+// with nullptr, for about seconds each, on one thread with fixed seeds.
+// Prints ns/op and ops/s. False when no name matched.
+bool run_benchmarks(const char *filter, double seconds);
+
+#endif // __BENCH_H__
@@ -0,0 +1,129 @@
+#ifndef __BVH_BUILD_H__
+#define __BVH_BUILD_H__
+
+// Internals shared by the BVH builders, only their sources include this.
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "bvh_node.h"
+
+const int   kBins = 16;
+const int   kMaxLeafSize = 4;
+const float kTraversalCost = 0.125;         // Relative to one primitive test.
+const int   kSpawnThreshold = 4096;         // Smaller subtrees are built on the current thread.
+const int   kParallelBinThreshold = 65536;  // Bigger ranges are binned on every core.
+const float kSBVHOverlap = 1.0e-5;          // Spatial splits are only tried when the object split children
+                                            // overlap by more than this fraction of the root area.
+const float kSBVHMaxGrowth = 0.5;           // Spatial splits stop once references exceed the primitives by this fraction.
+
+struct bvh_prim_ref
+{
+    aabb    box;
+    vec3    centroid;
+    int     index;
+};
+
+struct bvh_build_node
+{
+    aabb            box;
+    bvh_build_node  *child[2];
+    int             first,
+                    count,
+                    axis;
+    int             prims;  // Only kept by the linear builder, for the treelet pass.
+    float           cost;   // SAH cost weighted by the node area, idem.
+};
+
+// Internal node of the Karras hierarchy. Children >= 0 are internal nodes, ~index a leaf.
+struct lbvh_internal
+{
+    int     child[2],
+            first,
+            last;
+};
+
+struct sbvh_split;
+
+struct bvh_bin
+{
+    aabb    box;
+    int     count;
+};
+
+// Bins of a range along the three axes.
+struct bvh_range_info
+{
+    bvh_bin bins[3][kBins];
+};
+
+// Inlined surrounding(), the builder calls it for every primitive at every level.
+inline void grow(aabb &box, const aabb &b)
+{
+    for(int a = 0; a < 3; ++a) {
+        box._min[a] = ffmin(box._min[a], b._min[a]);
+        box._max[a] = ffmax(box._max[a], b._max[a]);
+    }
+}
+
+inline void grow(aabb &box, const vec3 &p)
+{
+    for(int a = 0; a < 3; ++a) {
+        box._min[a] = ffmin(box._min[a], p[a]);
+        box._max[a] = ffmax(box._max[a], p[a]);
+    }
+}
+
+// Small ranges use fewer bins, sweeping sixteen for a handful of primitives dominates the build.
+inline int bin_count(int n)
+{
+    return n < kBins / 2 ? 2 * n : kBins;
+}
+
+inline int bin_index(float c, float lo, float extent, int nbins)
+{
+    int b = int(nbins * ((c - lo) / extent));
+    return b < 0 ? 0 : (b >= nbins ? nbins - 1 : b);
+}
+
+void range_bounds(const bvh_prim_ref *refs, int begin, int end, aabb &box, aabb &cbox);
+void range_bins(const bvh_prim_ref *refs, int begin, int end, const aabb &cbox, int nbins, bvh_bin bins[3][kBins]);
+
+class bvh_builder
+{
+    public:
+        bvh_builder(hitable **l, int n, float time0, float time1);
+
+        bvh_build_node *build(int begin, int end, int depth);
+        bvh_build_node *build_lbvh(bool treelets);
+        bvh_build_node *build_sbvh();
+        int flatten(bvh_build_node *node, bvh_flat_node *nodes, int &next, int depth, std::vector<int> &order) const;
+
+        hitable                     **list;
+        float                       time0,
+                                    time1;
+        std::vector<bvh_prim_ref>   refs;
+        std::atomic<int>            node_count,
+                                    active_threads;
+        int                         max_threads;
+
+        // Spatial split builder state: references so far and the budget for them.
+        std::atomic<int>            ref_total;
+        int                         ref_budget;
+        float                       root_area;
+        std::mutex                  leaf_mutex;
+
+    private:
+        void bounds(int begin, int end, aabb &box, aabb &cbox) const;
+        void bins(int begin, int end, const aabb &cbox, int nbins, bvh_bin out[3][kBins]) const;
+        bvh_build_node *leaf(bvh_build_node *node, int begin, int end) const;
+        bvh_build_node *emit_lbvh(const lbvh_internal *internal, int child, int depth);
+        void optimize_treelets(bvh_build_node *node);
+        bvh_build_node *sbvh(std::vector<bvh_prim_ref> &work, int depth);
+        bvh_build_node *sbvh_leaf(bvh_build_node *node, const std::vector<bvh_prim_ref> &work);
+        bvh_prim_ref clip(const bvh_prim_ref &r, int axis, float lo, float hi) const;
+        void spatial_split(const std::vector<bvh_prim_ref> &work, const aabb &box, sbvh_split &best) const;
+};
+
+#endif // __BVH_BUILD_H__
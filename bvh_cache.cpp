@@ -0,0 +1,277 @@
+#include "bvh_cache.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "timeline.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+const char      kBVHCacheMagic[8] = { 'T', 'R', 'Y', 'L', 'B', 'V', 'H', 0 };
+const uint32_t  kEndianCheck = 0x01020304;
+const int       kKeyChunk = 65536;      // Fixed, so the key does not depend on the thread count.
+
+//
+// KEY
+//
+
+static inline uint64_t fnv1a(uint64_t h, uint32_t word)
+{
+    for(int i = 0; i < 4; ++i) {
+        h ^= (word >> (8 * i)) & 0xff;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static inline uint32_t float_bits(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+uint64_t bvh_cache_key(hitable **l, int n, float time0, float time1, bvh_build_method method)
+{
+    const uint64_t basis = 0xcbf29ce484222325ull;
+    int chunks = (n + kKeyChunk - 1) / kKeyChunk;
+    std::vector<uint64_t> partial(chunks, basis);
+
+    parallel_for(0, chunks, 1, [&](int begin, int end) {
+        for(int c = begin; c < end; ++c) {
+            uint64_t h = basis;
+
+            for(int i = c * kKeyChunk; i < n && i < (c + 1) * kKeyChunk; ++i) {
+                aabb box;
+                bool has_box = l[i]->bounding_box(time0, time1, box);
+
+                h = fnv1a(h, has_box);
+                for(int a = 0; a < 3; ++a) {
+                    h = fnv1a(h, float_bits(box.min()[a]));
+                    h = fnv1a(h, float_bits(box.max()[a]));
+                }
+            }
+
+            partial[c] = h;
+        }
+    });
+
+    uint64_t h = basis;
+    h = fnv1a(h, kBVHCacheVersion);
+    h = fnv1a(h, sizeof(bvh_flat_node));
+    h = fnv1a(h, method);
+    h = fnv1a(h, n);
+    h = fnv1a(h, float_bits(time0));
+    h = fnv1a(h, float_bits(time1));
+
+    for(int c = 0; c < chunks; ++c) {
+        h = fnv1a(h, uint32_t(partial[c]));
+        h = fnv1a(h, uint32_t(partial[c] >> 32));
+    }
+
+    return h;
+}
+
+//
+// LOAD / SAVE
+//
+
+static inline uint64_t align64(uint64_t offset)
+{
+    return (offset + 63) & ~uint64_t(63);
+}
+
+// Every offset in range and every child after its parent, no deeper than
+// the traversal stack, so a damaged file can not send traversal outside the
+// mapping. One pass: parents come first, their depth is known when reached.
+static bool valid_nodes(const bvh_flat_node *nodes, int node_count, int prim_count)
+{
+    std::vector<unsigned char> depth(node_count, 0);
+
+    for(int i = 0; i < node_count; ++i) {
+        const bvh_flat_node &node = nodes[i];
+
+        if( node.axis > 2 || depth[i] >= kBVHMaxDepth )
+            return false;
+
+        if( node.count > 0 ) {
+            if( node.offset < 0 || node.offset > prim_count - int(node.count) )
+                return false;
+        }
+        else {
+            if( i + 1 >= node_count || node.offset <= i + 1 || node.offset >= node_count )
+                return false;
+
+            depth[i + 1] = std::max<int>(depth[i + 1], depth[i] + 1);
+            depth[node.offset] = std::max<int>(depth[node.offset], depth[i] + 1);
+        }
+    }
+
+    return true;
+}
+
+// Whether count items of size bytes at offset lie inside a file of file_size
+// and are aligned for their type, the mapping itself starts on a page. Written
+// so that no sum can wrap around, whatever the header says.
+static bool fits(uint64_t offset, int32_t count, size_t size, size_t align, uint64_t file_size)
+{
+    return count >= 0 &&
+           offset % align == 0 &&
+           offset <= file_size &&
+           uint64_t(count) <= (file_size - offset) / size;
+}
+
+bvh_node *load_bvh_cache(const char *path, uint64_t key, hitable **l, int n)
+{
+    // Stays mapped for as long as the BVH lives, that is, the whole run.
+    mapped_file *file = new mapped_file;
+
+    if( !file->open(path) || file->size < sizeof(bvh_cache_header) ) {
+        delete file;
+        return nullptr;
+    }
+
+    const bvh_cache_header *h = reinterpret_cast<const bvh_cache_header *>(file->data);
+
+    bool valid = memcmp(h->magic, kBVHCacheMagic, sizeof(kBVHCacheMagic)) == 0 &&
+                 h->version == kBVHCacheVersion &&
+                 h->endian == kEndianCheck &&
+                 h->node_size == sizeof(bvh_flat_node) &&
+                 h->key == key &&
+                 h->primitives == n &&
+                 h->node_count > 0 &&
+                 h->prim_count >= 0 &&
+                 fits(h->nodes_offset, h->node_count, sizeof(bvh_flat_node), alignof(bvh_flat_node), file->size) &&
+                 fits(h->index_offset, h->prim_count, sizeof(int32_t), alignof(int32_t), file->size);
+
+    if( !valid ) {
+        std::cerr << "Rejecting stale BVH cache " << path << "\n";
+        delete file;
+        return nullptr;
+    }
+
+    if( !valid_nodes(reinterpret_cast<const bvh_flat_node *>(file->data + h->nodes_offset), h->node_count, h->prim_count) ) {
+        std::cerr << "Corrupt BVH cache " << path << "\n";
+        delete file;
+        return nullptr;
+    }
+
+    const int *index = reinterpret_cast<const int *>(file->data + h->index_offset);
+    hitable **prims = new hitable*[h->prim_count];
+
+    for(int i = 0; i < h->prim_count; ++i) {
+        if( index[i] < 0 || index[i] >= n ) {
+            std::cerr << "Corrupt BVH cache " << path << "\n";
+            delete[] prims;
+            delete file;
+            return nullptr;
+        }
+
+        prims[i] = l[index[i]];
+    }
+
+    bvh_node *bvh = new bvh_node;
+    bvh->nodes = reinterpret_cast<const bvh_flat_node *>(file->data + h->nodes_offset);
+    bvh->prim_index = index;
+    bvh->prims = prims;
+    bvh->node_count = h->node_count;
+    bvh->prim_count = h->prim_count;
+    bvh->box = bvh->nodes[0].box;
+
+    // The mapped nodes count too, they are paged in as the renders touch them.
+    account_memory(memory_bvh, (long long)h->node_count * sizeof(bvh_flat_node) + (long long)h->prim_count * (sizeof(int32_t) + sizeof(hitable *)), 0);
+
+    bvh->stats.method = bvh_build_method(h->method);
+    bvh->stats.primitives = n;
+    bvh->stats.nodes = h->node_count;
+    bvh->stats.references = h->prim_count;
+    bvh->stats.threads = 1;
+
+    return bvh;
+}
+
+bool save_bvh_cache(const char *path, uint64_t key, const bvh_node &bvh)
+{
+    bvh_cache_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, kBVHCacheMagic, sizeof(kBVHCacheMagic));
+    h.version = kBVHCacheVersion;
+    h.endian = kEndianCheck;
+    h.node_size = sizeof(bvh_flat_node);
+    h.method = bvh.stats.method;
+    h.key = key;
+    h.primitives = bvh.stats.primitives;
+    h.node_count = bvh.node_count;
+    h.prim_count = bvh.prim_count;
+    h.nodes_offset = align64(sizeof(h));
+    h.index_offset = align64(h.nodes_offset + uint64_t(h.node_count) * sizeof(bvh_flat_node));
+
+    // Written aside and renamed, a reader never maps a half written file.
+    std::string tmp = std::string(path) + ".tmp";
+    std::ofstream out(tmp.c_str(), std::ios::binary);
+    const char zeros[64] = { 0 };
+
+    out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    out.write(zeros, h.nodes_offset - sizeof(h));
+    out.write(reinterpret_cast<const char *>(bvh.nodes), uint64_t(h.node_count) * sizeof(bvh_flat_node));
+    out.write(zeros, h.index_offset - h.nodes_offset - uint64_t(h.node_count) * sizeof(bvh_flat_node));
+    out.write(reinterpret_cast<const char *>(bvh.prim_index), uint64_t(h.prim_count) * sizeof(int32_t));
+    out.close();
+
+    if( !out )
+        return false;
+
+    remove(path);
+    return rename(tmp.c_str(), path) == 0;
+}
+
+//
+// CACHED BVH
+//
+
+bvh_node *cached_bvh(hitable **l, int n, float time0, float time1, bvh_build_method method, const char *cache_dir)
+{
+    if( cache_dir == nullptr || n < kBVHCacheMinPrimitives )
+        return new bvh_node(l, n, time0, time1, method);
+
+    timeline_scope span("bvh_cache", "bvh");
+    span.arg("primitives", n);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t key = bvh_cache_key(l, n, time0, time1, method);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/bvh_%08x%08x.bin", cache_dir, unsigned(key >> 32), unsigned(key));
+
+    bvh_node *bvh = load_bvh_cache(path, key, l, n);
+
+    if( bvh ) {
+        bvh->stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "BVH: mapped " << path << ", " << bvh->stats << "\n";
+
+        return bvh;
+    }
+
+    bvh = new bvh_node(l, n, time0, time1, method);
+
+#ifdef _WIN32
+    _mkdir(cache_dir);
+#else
+    mkdir(cache_dir, 0755);
+#endif
+
+    if( !save_bvh_cache(path, key, *bvh) )
+        std::cerr << "Could not write BVH cache " << path << "\n";
+
+    return bvh;
+}
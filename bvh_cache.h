@@ -0,0 +1,45 @@
+#ifndef __BVH_CACHE_H__
+#define __BVH_CACHE_H__
+
+#include <stdint.h>
+
+#include "bvh_node.h"
+
+// Bump whenever bvh_flat_node or the builders change the trees they produce.
+const uint32_t kBVHCacheVersion = 2;
+
+// Smaller trees build in less time than a file takes to open.
+const int kBVHCacheMinPrimitives = 10000;
+
+// File layout: this header, then the node array and the primitive index
+// array at the given offsets, both 64 byte aligned and stored exactly as
+// bvh_node uses them, so a mapped file is traversed in place.
+struct bvh_cache_header
+{
+    char        magic[8];
+    uint32_t    version,
+                endian,         // 0x01020304 as seen by the writer.
+                node_size,      // sizeof(bvh_flat_node) of the writer.
+                method;
+    uint64_t    key;
+    int32_t     primitives,     // Length of the input list.
+                node_count,
+                prim_count,
+                pad;
+    uint64_t    nodes_offset,
+                index_offset;
+};
+
+// Hash of everything the tree depends on: the primitive bounds over the
+// shutter interval, the builder and the file format.
+uint64_t bvh_cache_key(hitable **l, int n, float time0, float time1, bvh_build_method method);
+
+bvh_node *load_bvh_cache(const char *path, uint64_t key, hitable **l, int n);
+bool save_bvh_cache(const char *path, uint64_t key, const bvh_node &bvh);
+
+// BVH over l, mapped from the cache directory when a file with the same key
+// is there, otherwise built and stored for the next run. With no directory,
+// or for small trees, it only builds.
+bvh_node *cached_bvh(hitable **l, int n, float time0, float time1, bvh_build_method method, const char *cache_dir);
+
+#endif // __BVH_CACHE_H__
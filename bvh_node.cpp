@@ -0,0 +1,588 @@
+#include "bvh_node.h"
+#include "bvh_build.h"
+#include "parallel.h"
+#include "stats.h"
+#include "timeline.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+//
+// BUILDER
+//
+
+void range_bounds(const bvh_prim_ref *refs, int begin, int end, aabb &box, aabb &cbox)
+{
+    box = cbox = empty_box();
+
+    for(int i = begin; i < end; ++i) {
+        grow(box, refs[i].box);
+        grow(cbox, refs[i].centroid);
+    }
+}
+
+void range_bins(const bvh_prim_ref *refs, int begin, int end, const aabb &cbox, int nbins, bvh_bin bins[3][kBins])
+{
+    vec3 extent = cbox.max() - cbox.min();
+
+    for(int a = 0; a < 3; ++a) {
+        for(int b = 0; b < nbins; ++b) {
+            bins[a][b].box = empty_box();
+            bins[a][b].count = 0;
+        }
+    }
+
+    for(int i = begin; i < end; ++i) {
+        for(int a = 0; a < 3; ++a) {
+            if(extent[a] <= 0.0)
+                continue;
+
+            bvh_bin &bin = bins[a][bin_index(refs[i].centroid[a], cbox.min()[a], extent[a], nbins)];
+            grow(bin.box, refs[i].box);
+            ++bin.count;
+        }
+    }
+}
+
+
+bvh_builder::bvh_builder(hitable **l, int n, float time0, float time1) :
+    list(l), time0(time0), time1(time1), refs(n), node_count(0), active_threads(1), max_threads(hardware_threads()), ref_total(n), ref_budget(n),
+    root_area(0.0)
+{
+    parallel_for(0, n, 4096, [&](int begin, int end) {
+        for(int i = begin; i < end; ++i) {
+            if( !l[i]->bounding_box(time0, time1, refs[i].box) ) {
+                std::cerr << "No bounding box in bvh_node constructor.\n";
+                refs[i].box = empty_box();
+            }
+            refs[i].centroid = 0.5 * (refs[i].box.min() + refs[i].box.max());
+            refs[i].index = i;
+        }
+    });
+}
+
+void bvh_builder::bounds(int begin, int end, aabb &box, aabb &cbox) const
+{
+    if(end - begin < kParallelBinThreshold) {
+        range_bounds(refs.data(), begin, end, box, cbox);
+        return;
+    }
+
+    std::vector<aabb> boxes(max_threads), cboxes(max_threads);
+
+    parallel_chunks(begin, end, max_threads, [&](int c, int b, int e) {
+        range_bounds(refs.data(), b, e, boxes[c], cboxes[c]);
+    });
+
+    box = cbox = empty_box();
+    for(int c = 0; c < max_threads; ++c) {
+        grow(box, boxes[c]);
+        grow(cbox, cboxes[c]);
+    }
+}
+
+void bvh_builder::bins(int begin, int end, const aabb &cbox, int nbins, bvh_bin out[3][kBins]) const
+{
+    if(end - begin < kParallelBinThreshold) {
+        range_bins(refs.data(), begin, end, cbox, nbins, out);
+        return;
+    }
+
+    std::vector<bvh_range_info> partial(max_threads);
+
+    for(auto &p : partial)
+        range_bins(refs.data(), 0, 0, cbox, nbins, p.bins);
+
+    parallel_chunks(begin, end, max_threads, [&](int c, int b, int e) {
+        range_bins(refs.data(), b, e, cbox, nbins, partial[c].bins);
+    });
+
+    range_bins(refs.data(), 0, 0, cbox, nbins, out);
+    for(auto &p : partial) {
+        for(int a = 0; a < 3; ++a) {
+            for(int b = 0; b < nbins; ++b) {
+                grow(out[a][b].box, p.bins[a][b].box);
+                out[a][b].count += p.bins[a][b].count;
+            }
+        }
+    }
+}
+
+bvh_build_node *bvh_builder::leaf(bvh_build_node *node, int begin, int end) const
+{
+    node->child[0] = node->child[1] = nullptr;
+    node->first = begin;
+    node->count = end - begin;
+    node->axis = 0;
+
+    return node;
+}
+
+bvh_build_node *bvh_builder::build(int begin, int end, int depth)
+{
+    bvh_build_node *node = new bvh_build_node;
+    ++node_count;
+
+    int n = end - begin;
+    aabb cbox;
+    bounds(begin, end, node->box, cbox);
+
+    if( n == 1 || depth >= kBVHMaxDepth - 1 )
+        return leaf(node, begin, end);
+
+    vec3 extent = cbox.max() - cbox.min();
+    int mid = begin + n / 2;
+    int axis = 0;
+
+    if( extent.x() <= 0.0 && extent.y() <= 0.0 && extent.z() <= 0.0 ) {
+        // Every centroid in the same spot, no split can separate them.
+        if( n <= kMaxLeafSize )
+            return leaf(node, begin, end);
+    }
+    else {
+        int nbins = bin_count(n);
+        bvh_range_info *info = new bvh_range_info;
+        bins(begin, end, cbox, nbins, info->bins);
+
+        float best_cost = FLT_MAX;
+        int best_split = -1;
+
+        for(int a = 0; a < 3; ++a) {
+            if(extent[a] <= 0.0)
+                continue;
+
+            // Sweep from the right storing the cost of every right side, then from the left.
+            float right_cost[kBins];
+            aabb acc = empty_box();
+            int count = 0;
+
+            for(int b = nbins - 1; b > 0; --b) {
+                grow(acc, info->bins[a][b].box);
+                count += info->bins[a][b].count;
+                right_cost[b] = count * acc.surface_area();
+            }
+
+            acc = empty_box();
+            count = 0;
+
+            for(int b = 0; b < nbins - 1; ++b) {
+                grow(acc, info->bins[a][b].box);
+                count += info->bins[a][b].count;
+
+                if(count == 0 || count == n)
+                    continue;
+
+                float cost = count * acc.surface_area() + right_cost[b + 1];
+
+                if(cost < best_cost) {
+                    best_cost = cost;
+                    best_split = b;
+                    axis = a;
+                }
+            }
+        }
+
+        delete info;
+
+        float area = node->box.surface_area();
+        float split_cost = kTraversalCost + (area > 0.0 ? best_cost / area : 0.0);
+
+        if( n <= kMaxLeafSize && (best_split < 0 || split_cost >= n) )
+            return leaf(node, begin, end);
+
+        if( best_split >= 0 ) {
+            float lo = cbox.min()[axis];
+            float ext = extent[axis];
+            bvh_prim_ref *m = std::partition(refs.data() + begin, refs.data() + end,
+                [=](const bvh_prim_ref &r) { return bin_index(r.centroid[axis], lo, ext, nbins) <= best_split; });
+            mid = int(m - refs.data());
+        }
+        else {
+            // All centroids fell in one bin, fall back to the object median.
+            axis = extent.x() > extent.y() ? (extent.x() > extent.z() ? 0 : 2) : (extent.y() > extent.z() ? 1 : 2);
+            std::nth_element(refs.data() + begin, refs.data() + mid, refs.data() + end,
+                [=](const bvh_prim_ref &a, const bvh_prim_ref &b) { return a.centroid[axis] < b.centroid[axis]; });
+        }
+    }
+
+    node->axis = axis;
+    node->first = node->count = 0;
+
+    if( n >= kSpawnThreshold && active_threads.fetch_add(1) < max_threads ) {
+        std::thread left([=]() { perf_phase_scope scope(perf_phase_bvh); node->child[0] = build(begin, mid, depth + 1); });
+        node->child[1] = build(mid, end, depth + 1);
+        left.join();
+        --active_threads;
+    }
+    else {
+        if( n >= kSpawnThreshold )
+            --active_threads;
+
+        node->child[0] = build(begin, mid, depth + 1);
+        node->child[1] = build(mid, end, depth + 1);
+    }
+
+    return node;
+}
+
+// Appends the primitives under a node in depth first order, freeing the subtree.
+static void collect(bvh_build_node *node, const std::vector<bvh_prim_ref> &refs, std::vector<int> &order)
+{
+    if( node->count > 0 ) {
+        for(int i = node->first; i < node->first + node->count; ++i)
+            order.push_back(refs[i].index);
+    }
+    else {
+        collect(node->child[0], refs, order);
+        collect(node->child[1], refs, order);
+    }
+
+    delete node;
+}
+
+// Primitives are laid out in depth first order, so every subtree covers a
+// contiguous range whatever the builder did, and subtrees deeper than the
+// traversal stack allows are folded into a single leaf.
+int bvh_builder::flatten(bvh_build_node *node, bvh_flat_node *nodes, int &next, int depth, std::vector<int> &order) const
+{
+    int index = next++;
+
+    nodes[index].box = node->box;
+    nodes[index].axis = node->axis;
+
+    if( node->count > 0 || depth >= kBVHMaxDepth - 1 ) {
+        nodes[index].offset = int(order.size());
+        collect(node, refs, order);
+        assert(int(order.size()) - nodes[index].offset <= kBVHMaxLeafPrims);
+        nodes[index].count = int(order.size()) - nodes[index].offset;
+
+        return index;
+    }
+
+    flatten(node->child[0], nodes, next, depth + 1, order);
+    nodes[index].offset = flatten(node->child[1], nodes, next, depth + 1, order);
+    nodes[index].count = 0;
+
+    delete node;
+
+    return index;
+}
+
+//
+// BVH NODE
+//
+
+bvh_node::bvh_node(hitable **l, int n, float time0, float time1, bvh_build_method method) :
+    prims(nullptr), prim_index(nullptr), nodes(nullptr), node_count(0), prim_count(0)
+{
+    auto start = std::chrono::steady_clock::now();
+    timeline_scope span("bvh_build", "bvh");
+    span.arg("primitives", n);
+
+    stats.method = method;
+    stats.primitives = n;
+    stats.nodes = stats.references = 0;
+    stats.threads = hardware_threads();
+    stats.seconds = 0.0;
+
+    if( n < 1 )
+        return;
+
+    bvh_builder builder(l, n, time0, time1);
+    bvh_build_node *root = nullptr;
+
+    if( method == bvh_sah )
+        root = builder.build(0, n, 0);
+    else if( method == bvh_sbvh )
+        root = builder.build_sbvh();
+    else
+        root = builder.build_lbvh(method == bvh_lbvh_treelet);
+
+    std::vector<int> order;
+    order.reserve(builder.refs.size());
+    bvh_flat_node *flat = new bvh_flat_node[builder.node_count];
+
+    builder.flatten(root, flat, node_count, 0, order);
+
+    int *index = new int[order.size()];
+    prim_count = int(order.size());
+    prims = new hitable*[prim_count];
+
+    for(int i = 0; i < prim_count; ++i) {
+        index[i] = order[i];
+        prims[i] = l[order[i]];
+    }
+
+    nodes = flat;
+    prim_index = index;
+    box = nodes[0].box;
+
+    account_memory(memory_bvh, (long long)node_count * sizeof(bvh_flat_node) + (long long)prim_count * (sizeof(int) + sizeof(hitable *)), 0);
+
+    stats.nodes = node_count;
+    stats.references = prim_count;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cerr << "BVH: " << stats << "\n";
+}
+
+bool bvh_node::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
+{
+    if( node_count == 0 )
+        return false;
+
+    return hit_from(0, r, tmin, tmax, rec);
+}
+
+bool bvh_node::hit_from(int root, const ray &r, float tmin, float tmax, hit_record &rec) const
+{
+    vec3 inv_dir(1.0f / r.direction().x(), 1.0f / r.direction().y(), 1.0f / r.direction().z());
+    int dir_neg[3] = { inv_dir.x() < 0.0f, inv_dir.y() < 0.0f, inv_dir.z() < 0.0f };
+
+    int stack[kBVHMaxDepth];
+    int sp = 0;
+    int current = root;
+    bool hit_anything = false;
+
+    while(true) {
+        const bvh_flat_node &node = nodes[current];
+        RT_STAT(bvh_nodes);
+
+        if( node.box.hit(r, inv_dir, tmin, tmax) ) {
+            if( node.count > 0 ) {
+                for(int i = 0; i < node.count; ++i) {
+                    RT_STAT(prim_tests);
+                    if( prims[node.offset + i]->hit(r, tmin, tmax, rec) ) {
+                        hit_anything = true;
+                        tmax = rec.t;
+                    }
+                }
+            }
+            else {
+                // Visit the child nearest to the ray origin first, to shrink tmax sooner.
+                if( dir_neg[node.axis] ) {
+                    stack[sp++] = current + 1;
+                    current = node.offset;
+                }
+                else {
+                    stack[sp++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+
+        if( sp == 0 )
+            break;
+
+        current = stack[--sp];
+    }
+
+    return hit_anything;
+}
+
+// No ordering and no tmax to shrink, the first primitive hit ends the traversal.
+bool bvh_node::occluded(const ray &r, float tmin, float tmax) const
+{
+    if( node_count == 0 )
+        return false;
+
+    return occluded_from(0, r, tmin, tmax);
+}
+
+bool bvh_node::occluded_from(int root, const ray &r, float tmin, float tmax) const
+{
+    vec3 inv_dir(1.0f / r.direction().x(), 1.0f / r.direction().y(), 1.0f / r.direction().z());
+
+    int stack[kBVHMaxDepth];
+    int sp = 0;
+    int current = root;
+
+    while(true) {
+        const bvh_flat_node &node = nodes[current];
+        RT_STAT(bvh_nodes);
+
+        if( node.box.hit(r, inv_dir, tmin, tmax) ) {
+            if( node.count > 0 ) {
+                for(int i = 0; i < node.count; ++i) {
+                    RT_STAT(prim_tests);
+                    if( prims[node.offset + i]->occluded(r, tmin, tmax) )
+                        return true;
+                }
+            }
+            else {
+                stack[sp++] = node.offset;
+                current = current + 1;
+                continue;
+            }
+        }
+
+        if( sp == 0 )
+            break;
+
+        current = stack[--sp];
+    }
+
+    return false;
+}
+
+//
+// PACKETS
+//
+
+struct bvh_packet_entry
+{
+    int         node;
+    packet_mask mask;   // Lanes that hit the parent box.
+};
+
+static float packet_tmax(const ray_packet &p, packet_mask mask)
+{
+    float t = -FLT_MAX;
+    for(int i = 0; i < p.size; ++i) {
+        if( mask >> i & 1 )
+            t = ffmax(t, p.tmax[i]);
+    }
+    return t;
+}
+
+// The packet goes down together while enough of its rays hit the boxes. A
+// node that interval arithmetic rules out for all of them costs one test
+// instead of one per ray. Incoherent packets and the few rays left in a
+// subtree go one at a time.
+packet_mask bvh_node::hit_packet(ray_packet &p, packet_mask mask, hit_record *recs) const
+{
+    if( node_count == 0 )
+        return 0;
+
+    if( !p.coherent )
+        return hitable::hit_packet(p, mask, recs);
+
+    bvh_packet_entry stack[kBVHMaxDepth];
+    int sp = 0;
+    int current = 0;
+    packet_mask active = mask,
+                hits = 0;
+
+    while(true) {
+        const bvh_flat_node &node = nodes[current];
+        RT_STAT(bvh_nodes);
+
+        packet_mask m = 0;
+        if( !p.culled(node.box, packet_tmax(p, active)) )
+            m = p.box_hit(node.box, active);
+
+        if( m && lane_count(m) < kPacketMinActive ) {
+            for(int i = 0; i < p.size; ++i) {
+                if( (m >> i & 1) && hit_from(current, p.get(i), p.tmin, p.tmax[i], recs[i]) ) {
+                    p.tmax[i] = recs[i].t;
+                    hits |= 1u << i;
+                }
+            }
+        }
+        else if( m ) {
+            if( node.count > 0 ) {
+                for(int i = 0; i < node.count; ++i) {
+                    RT_STAT(prim_tests);
+                    hits |= prims[node.offset + i]->hit_packet(p, m, recs);
+                }
+            }
+            else {
+                // Every ray has the same direction signs, so the same child is nearest for all.
+                if( p.dir_neg[node.axis] ) {
+                    stack[sp++] = { current + 1, m };
+                    current = node.offset;
+                }
+                else {
+                    stack[sp++] = { node.offset, m };
+                    current = current + 1;
+                }
+                active = m;
+                continue;
+            }
+        }
+
+        if( sp == 0 )
+            break;
+
+        --sp;
+        current = stack[sp].node;
+        active = stack[sp].mask;
+    }
+
+    return hits;
+}
+
+packet_mask bvh_node::occluded_packet(const ray_packet &p, packet_mask mask) const
+{
+    if( node_count == 0 )
+        return 0;
+
+    if( !p.coherent )
+        return hitable::occluded_packet(p, mask);
+
+    bvh_packet_entry stack[kBVHMaxDepth];
+    int sp = 0;
+    int current = 0;
+    packet_mask active = mask,
+                blocked = 0;
+
+    while(true) {
+        const bvh_flat_node &node = nodes[current];
+        RT_STAT(bvh_nodes);
+
+        // Rays already blocked are done.
+        active &= ~blocked;
+
+        packet_mask m = 0;
+        if( active && !p.culled(node.box, packet_tmax(p, active)) )
+            m = p.box_hit(node.box, active);
+
+        if( m && lane_count(m) < kPacketMinActive ) {
+            for(int i = 0; i < p.size; ++i) {
+                if( (m >> i & 1) && occluded_from(current, p.get(i), p.tmin, p.tmax[i]) )
+                    blocked |= 1u << i;
+            }
+        }
+        else if( m ) {
+            if( node.count > 0 ) {
+                for(int i = 0; i < node.count && (m & ~blocked); ++i) {
+                    RT_STAT(prim_tests);
+                    blocked |= prims[node.offset + i]->occluded_packet(p, m & ~blocked);
+                }
+            }
+            else {
+                stack[sp++] = { node.offset, m };
+                current = current + 1;
+                active = m;
+                continue;
+            }
+        }
+
+        if( sp == 0 || blocked == mask )
+            break;
+
+        --sp;
+        current = stack[sp].node;
+        active = stack[sp].mask;
+    }
+
+    return blocked;
+}
+
+std::ostream& operator<<(std::ostream &os, const bvh_build_stats &s)
+{
+    const char *names[] = { "SAH", "LBVH", "LBVH+treelets", "SBVH" };
+    double per_million = s.primitives > 0 ? s.seconds * 1.0e6 / s.primitives : 0.0;
+
+    os << names[s.method] << ", " << s.primitives << " primitives, ";
+    if( s.references != s.primitives )
+        os << s.references << " references, ";
+    os << s.nodes << " nodes, "
+       << s.seconds * 1000.0 << " ms on " << s.threads << " threads ("
+       << per_million << " s per million primitives)";
+
+    return os;
+}
@@ -1,137 +1,80 @@
 #ifndef __BVH_NODE_H__
 #define __BVH_NODE_H__
 
+#include <iostream>
+
 #include "hitables.h"
 #include "aabb.h"
-#include "rangen.h"
 
-int box_x_compare(const void *a, const void *b);
-int box_y_compare(const void *a, const void *b);
-int box_z_compare(const void *a, const void *b);
+// Deepest tree the builders produce, and so the traversal stack size.
+const int kBVHMaxDepth = 64;
+
+// Most primitives a leaf can hold. Subtrees below the depth cap are folded
+// into one leaf whatever their size, so it has to hold nearly all of them.
+const int kBVHMaxLeafPrims = (1 << 30) - 1;
 
-class bvh_node : public hitable 
+// Node of the flattened tree. The first child of an interior node is always
+// the next node in the array, so only the second one has to be stored.
+struct bvh_flat_node
 {
-    public:
-        bvh_node() {}
-        bvh_node(hitable **l, int n, float time0, float time1);
-        
-        virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
-        virtual bool bounding_box(float t0, float t1, aabb &b) const
-        {
-            b = box;
-            return true;
-        }
-        
-        hitable *left,
-                *right;
-        aabb    box;
+    aabb            box;
+    int             offset;     // Interior: index of the second child. Leaf: first primitive.
+    unsigned int    count : 30, // Primitives in the leaf, 0 for interior nodes.
+                    axis : 2;   // Split axis, to visit the nearest child first.
 };
 
-bool bvh_node::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
-{
-    if(box.hit(r, tmin, tmax)) {
-        hit_record right_rec, left_rec;
-        
-        bool hit_left = left->hit(r, tmin, tmax, left_rec);
-        bool hit_right = right->hit(r, tmin, tmax, right_rec);
-        
-        if( hit_left && hit_right ) {
-            if( left_rec.t < right_rec.t )
-                rec = left_rec;
-            else
-                rec = right_rec;
-                
-            return true;
-        }
-        else if(hit_left) {
-            rec = left_rec;
-            return true;
-        }
-        else if(hit_right) {
-            rec = right_rec;
-            return true;
-        }
-        else
-            return false;
-    }
-    else
-        return false;
-}
+static_assert(sizeof(bvh_flat_node) == 32, "bvh_flat_node should fill half a cache line");
 
-bvh_node::bvh_node(hitable **l, int n, float time0, float time1)
+enum bvh_build_method
 {
-    int axis = int(3 * drand48());
-    
-    if( axis == 0 )
-        std::qsort(l, n, sizeof(hitable *), box_x_compare);
-    else if( axis == 1 )
-        std::qsort(l, n, sizeof(hitable *), box_y_compare);
-    else
-        std::qsort(l, n, sizeof(hitable *), box_z_compare);
-        
-    if( n== 1) {
-        left = l[0];
-        right = l[1];
-    }
-    else if( n== 2) {
-        left = l[0];
-        right = l[1];
-    }
-    else {
-        left = new bvh_node(l, n/2, time0, time1);
-        right = new bvh_node(l + n/2, n - n/2, time0, time1);
-    }
-    
-    aabb box_left, box_right;
-    if( !left->bounding_box(time0, time1, box_left) || !right->bounding_box(time0, time1, box_right))
-        std::cerr << "No bounding box in bvh_node constructor.\n";
-    
-    box = surrounding(box_left, box_right);
-}
+    bvh_sah,            // Binned SAH, the best trees.
+    bvh_lbvh,           // Morton-code linear BVH, the fastest build.
+    bvh_lbvh_treelet,   // Linear BVH plus treelet restructuring, close to SAH quality.
+    bvh_sbvh            // SAH with spatial splits, for large overlapping primitives. Slowest build.
+};
 
-int box_x_compare(const void *a, const void *b)
+struct bvh_build_stats
 {
-    aabb box_left, box_right;
-    hitable *ah = *(hitable **)a;
-    hitable *bh = *(hitable **)b;
-    
-    if( !ah->bounding_box(0, 0, box_left) || !bh->bounding_box(0, 0, box_left) )
-        std::cerr << "No bounding box in bvh_node constructor.\n";
-        
-    if( box_left.min().x() - box_right.min().x() < 0.0 )
-        return -1;
-    else
-        return 1;
-}
+    bvh_build_method method;
+    int     primitives,
+            nodes,
+            references,     // Primitive references in the leaves, more than primitives with spatial splits.
+            threads;
+    double  seconds;
+};
 
-int box_y_compare(const void *a, const void *b)
-{
-    aabb box_left, box_right;
-    hitable *ah = *(hitable **)a;
-    hitable *bh = *(hitable **)b;
-    
-    if( !ah->bounding_box(0, 0, box_left) || !bh->bounding_box(0, 0, box_left) )
-        std::cerr << "No bounding box in bvh_node constructor.\n";
-        
-    if( box_left.min().y() - box_right.min().y() < 0.0 )
-        return -1;
-    else
-        return 1;
-}
+std::ostream& operator<<(std::ostream &os, const bvh_build_stats &s);
 
-int box_z_compare(const void *a, const void *b)
+class bvh_node : public hitable
 {
-    aabb box_left, box_right;
-    hitable *ah = *(hitable **)a;
-    hitable *bh = *(hitable **)b;
-    
-    if( !ah->bounding_box(0, 0, box_left) || !bh->bounding_box(0, 0, box_left) )
-        std::cerr << "No bounding box in bvh_node constructor.\n";
+    public:
+        RT_MEMORY_CATEGORY(memory_bvh)
         
-    if( box_left.min().z() - box_right.min().z() < 0.0 )
-        return -1;
-    else
-        return 1;
-}
+        bvh_node() : prims(nullptr), prim_index(nullptr), nodes(nullptr), node_count(0), prim_count(0) {}
+        bvh_node(hitable **l, int n, float time0, float time1, bvh_build_method method = bvh_sah);
+
+        virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
+        virtual packet_mask hit_packet(ray_packet &p, packet_mask mask, hit_record *recs) const;
+        virtual packet_mask occluded_packet(const ray_packet &p, packet_mask mask) const;
+        virtual bool bounding_box(float t0, float t1, aabb &b) const
+        {
+            b = box;
+            return node_count > 0;
+        }
+
+        hitable             **prims;
+        const int           *prim_index;    // Position in the input list of every entry in prims.
+        const bvh_flat_node *nodes;
+        int                 node_count,
+                            prim_count;
+        aabb                box;
+        bvh_build_stats     stats;
+
+    private:
+        // Single ray traversal of the subtree under node root.
+        bool hit_from(int root, const ray &r, float tmin, float tmax, hit_record &rec) const;
+        bool occluded_from(int root, const ray &r, float tmin, float tmax) const;
+};
 
 #endif // __BVH_NODE_H__
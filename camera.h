@@ -4,9 +4,7 @@
 #include "ray.h"
 #include "rangen.h"
 
-const double kPI = 3.141592653589793;
-
-vec3 random_in_unit_disk()
+inline vec3 random_in_unit_disk()
 {
     vec3 p;
     do {
@@ -0,0 +1,146 @@
+#include "compile.h"
+#include "bvh_cache.h"
+#include "instances.h"
+#include "constant_medium.h"
+#include "timeline.h"
+
+#include <algorithm>
+#include <vector>
+
+struct compile_context
+{
+    float               time0,
+                        time1;
+    bvh_build_method    method;
+    const char          *cache_dir;
+    compile_stats       stats;
+};
+
+static hitable *accelerate(hitable *h, compile_context &ctx);
+
+// Instances keep their place in the primitive set, the groups inside them are accelerated apart.
+static void accelerate_children(hitable *h, compile_context &ctx)
+{
+    if( translate *t = dynamic_cast<translate *>(h) )
+        t->ptr = accelerate(t->ptr, ctx);
+    else if( rotate_y *r = dynamic_cast<rotate_y *>(h) )
+        r->ptr = accelerate(r->ptr, ctx);
+    else if( flip_normals *f = dynamic_cast<flip_normals *>(h) )
+        f->ptr = accelerate(f->ptr, ctx);
+    else if( constant_medium *c = dynamic_cast<constant_medium *>(h) )
+        c->boundary = accelerate(c->boundary, ctx);
+}
+
+static void gather(hitable *h, std::vector<hitable *> &prims, compile_context &ctx)
+{
+    if( hitable_list *l = dynamic_cast<hitable_list *>(h) ) {
+        ++ctx.stats.lists;
+        for(int i = 0; i < l->list_size; ++i)
+            gather(l->list[i], prims, ctx);
+    }
+    else if( box *b = dynamic_cast<box *>(h) ) {
+        ++ctx.stats.boxes;
+        gather(b->list_ptr, prims, ctx);
+    }
+    else if( bvh_node *b = dynamic_cast<bvh_node *>(h) ) {
+        // Take every input primitive once, whatever the tree references.
+        std::vector<bool> seen(b->stats.primitives, false);
+
+        for(int i = 0; i < b->prim_count; ++i) {
+            if( !seen[b->prim_index[i]] ) {
+                seen[b->prim_index[i]] = true;
+                gather(b->prims[i], prims, ctx);
+            }
+        }
+    }
+    else {
+        accelerate_children(h, ctx);
+        prims.push_back(h);
+    }
+}
+
+// Unbounded primitives, and those whose box is most of the scene's (a ground
+// sphere, a fog sphere around everything), are tested on their own: in the
+// BVH they would overlap every node and give the root a box every ray hits.
+static hitable *build(std::vector<hitable *> &prims, compile_context &ctx)
+{
+    if( prims.size() == 1 )
+        return prims[0];
+
+    aabb scene_box = empty_box();
+    std::vector<aabb> boxes(prims.size());
+    std::vector<bool> bounded(prims.size());
+
+    for(size_t i = 0; i < prims.size(); ++i) {
+        bounded[i] = prims[i]->bounding_box(ctx.time0, ctx.time1, boxes[i]);
+        if( bounded[i] )
+            scene_box = surrounding(scene_box, boxes[i]);
+    }
+
+    std::vector<hitable *> inside,
+                           outside;
+
+    for(size_t i = 0; i < prims.size(); ++i) {
+        if( !bounded[i] || boxes[i].surface_area() > kEnclosingFraction * scene_box.surface_area() )
+            outside.push_back(prims[i]);
+        else
+            inside.push_back(prims[i]);
+    }
+
+    ctx.stats.outliers += int(outside.size());
+
+    if( inside.size() == 1 )
+        outside.push_back(inside[0]);
+    else if( inside.size() > 1 ) {
+        ++ctx.stats.bvhs;
+        outside.push_back(cached_bvh(inside.data(), int(inside.size()), ctx.time0, ctx.time1, ctx.method, ctx.cache_dir));
+    }
+
+    if( outside.size() == 1 )
+        return outside[0];
+
+    // Outliers first, a ground plane hit shortens the ray before the BVH.
+    hitable **list = new hitable*[outside.size()];
+    std::copy(outside.begin(), outside.end(), list);
+
+    return new hitable_list(list, int(outside.size()));
+}
+
+static hitable *accelerate(hitable *h, compile_context &ctx)
+{
+    std::vector<hitable *> prims;
+    gather(h, prims, ctx);
+
+    return build(prims, ctx);
+}
+
+hitable *compile_world(hitable *world, float time0, float time1, bvh_build_method method, const char *cache_dir,
+                       compile_stats *stats)
+{
+    timeline_scope span("compile_world", "bvh");
+    compile_context ctx;
+    ctx.time0 = time0;
+    ctx.time1 = time1;
+    ctx.method = method;
+    ctx.cache_dir = cache_dir;
+    ctx.stats.primitives = ctx.stats.lists = ctx.stats.boxes = ctx.stats.bvhs = ctx.stats.outliers = 0;
+
+    std::vector<hitable *> prims;
+    gather(world, prims, ctx);
+    ctx.stats.primitives = int(prims.size());
+
+    hitable *compiled = build(prims, ctx);
+
+    if( stats )
+        *stats = ctx.stats;
+
+    return compiled;
+}
+
+std::ostream& operator<<(std::ostream &os, const compile_stats &s)
+{
+    os << s.primitives << " primitives from " << s.lists << " lists and " << s.boxes << " boxes, "
+       << s.bvhs << " BVHs, " << s.outliers << " kept out of them";
+
+    return os;
+}
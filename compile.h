@@ -0,0 +1,31 @@
+#ifndef __COMPILE_H__
+#define __COMPILE_H__
+
+#include "hitables.h"
+#include "bvh_node.h"
+
+struct compile_stats
+{
+    int     primitives,
+            lists,          // Nested hitable_lists dissolved.
+            boxes,          // Boxes split into their six faces.
+            bvhs,           // Accelerators built, one for the world plus one per instanced group.
+            outliers;       // Unbounded or scene sized primitives tested outside the BVHs.
+};
+
+// A primitive whose box has more than this fraction of the surface area of
+// the whole scene's is left out of the BVH. A Cornell box wall has a third.
+const float kEnclosingFraction = 0.5;
+
+// Turns a scene as written by its author into what gets traced: nested
+// hitable_lists, boxes and hand built BVHs are dissolved into a single set
+// of primitives, which goes into one BVH built with 'method'. Groups under
+// an instance (translate, rotate_y, flip_normals, constant_medium) get their
+// own BVH, since they are traced in another space. Unbounded and scene
+// enclosing primitives stay outside the BVHs, in a list next to them.
+hitable *compile_world(hitable *world, float time0, float time1, bvh_build_method method, const char *cache_dir,
+                       compile_stats *stats = nullptr);
+
+std::ostream& operator<<(std::ostream &os, const compile_stats &s);
+
+#endif // __COMPILE_H__
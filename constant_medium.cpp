@@ -0,0 +1,60 @@
+#include "constant_medium.h"
+
+bool constant_medium::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
+{
+    RT_STAT(prim_class_tests[stat_medium]);
+    bool db = (drand48() < 0.00001);
+    db = false;
+    hit_record rec1, rec2;
+    
+    if( boundary->hit(r, -FLT_MAX, FLT_MAX, rec1) ) { 
+        if( boundary->hit(r, rec1.t+0.0001, FLT_MAX, rec2 )) {
+            if (db) std::cerr << "\nt0 t1 " << rec1.t << " " << rec2.t << "\n";
+            if (rec1.t < tmin)
+                rec1.t = tmin;
+            if (rec2.t > tmax)
+                rec2.t = tmax;
+            if (rec1.t >= rec2.t)
+                return false;
+            if (rec1.t < 0)
+                rec1.t = 0;
+            float distance_inside_boundary = (rec2.t - rec1.t)*r.direction().length();
+            float hit_distance = -(1/density)*log(drand48()); 
+            if ( hit_distance < distance_inside_boundary ) {
+                if (db) std::cerr << "hit_distance = " <<  hit_distance << "\n";
+                rec.t = rec1.t + hit_distance / r.direction().length(); 
+                if (db) std::cerr << "rec.t = " <<  rec.t << "\n";
+                rec.p = r.point_at_parameter(rec.t);
+                if (db) std::cerr << "rec.p = " <<  rec.p << "\n";
+                rec.normal = vec3(1,0,0);  // arbitrary
+                rec.mat_ptr = phase_function;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Same sampling as hit(), a ray is blocked when it would scatter before tmax.
+bool constant_medium::occluded(const ray &r, float tmin, float tmax) const
+{
+    RT_STAT(prim_class_tests[stat_medium]);
+    hit_record rec1, rec2;
+    
+    if( !boundary->hit(r, -FLT_MAX, FLT_MAX, rec1) || !boundary->hit(r, rec1.t+0.0001, FLT_MAX, rec2) )
+        return false;
+    
+    if (rec1.t < tmin)
+        rec1.t = tmin;
+    if (rec2.t > tmax)
+        rec2.t = tmax;
+    if (rec1.t >= rec2.t)
+        return false;
+    if (rec1.t < 0)
+        rec1.t = 0;
+    
+    float distance_inside_boundary = (rec2.t - rec1.t)*r.direction().length();
+    float hit_distance = -(1/density)*log(drand48());
+    
+    return hit_distance < distance_inside_boundary;
+}
@@ -0,0 +1,315 @@
+#include "converge.h"
+#include "compile.h"
+#include "image_io.h"
+#include "parallel.h"
+#include "rangen.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Keeps relMSE finite in black pixels, the usual value.
+const float kRelMSEEpsilon = 0.01;
+
+// Part of the reference file names. Raise it whenever the scenes render
+// differently, references cached before are then rendered again.
+const int kReferenceVersion = 2;
+
+struct converge_row
+{
+    std::string label,
+                scene;
+    int         nx, ny, spp;
+    double      seconds, rmse, relmse;
+};
+
+//
+// REFERENCE
+//
+
+static bool load_reference(const std::string &path, int nx, int ny, std::vector<float> &values)
+{
+    int width, height, channels;
+
+    return read_pfm(path.c_str(), values, width, height, channels) && width == nx && height == ny && channels == 3;
+}
+
+static void render_reference(scene &the_scene, const converge_options &options, const std::string &path, std::vector<float> &values)
+{
+    render_options reference = default_render_options();
+    reference.threads = options.render.threads;
+
+    std::cerr << "Reference: " << path << ", " << options.reference_spp << " spp\n";
+
+    // Different samples from the ones the candidates get.
+    seed_drand48(the_scene.seed ^ 0x5bd1e995u);
+    the_scene.ns = options.reference_spp;
+
+    std::vector<vec3> image(the_scene.nx * the_scene.ny);
+    render(the_scene, reference, image.data());
+
+    values.resize(3 * image.size());
+    for(size_t i = 0; i < image.size(); ++i) {
+        for(int c = 0; c < 3; ++c)
+            values[3 * i + c] = image[i][c];
+    }
+
+#ifdef _WIN32
+    _mkdir(options.reference_dir);
+#else
+    mkdir(options.reference_dir, 0755);
+#endif
+
+    if( !write_pfm(path.c_str(), values.data(), the_scene.nx, the_scene.ny, 3) )
+        std::cerr << "Could not write the reference " << path << "\n";
+}
+
+//
+// RESULTS
+//
+
+static std::vector<converge_row> read_rows(const std::string &path)
+{
+    std::vector<converge_row> rows;
+    std::ifstream file(path);
+    std::string line;
+
+    std::getline(file, line);
+
+    while( std::getline(file, line) ) {
+        std::vector<std::string> fields;
+        std::stringstream in(line);
+        std::string field;
+
+        while( std::getline(in, field, ',') )
+            fields.push_back(field);
+
+        if( fields.size() < 8 )
+            continue;
+
+        converge_row r;
+        r.label = fields[0];
+        r.scene = fields[1];
+        r.nx = atoi(fields[2].c_str());
+        r.ny = atoi(fields[3].c_str());
+        r.spp = atoi(fields[4].c_str());
+        r.seconds = atof(fields[5].c_str());
+        r.rmse = atof(fields[6].c_str());
+        r.relmse = atof(fields[7].c_str());
+        rows.push_back(r);
+    }
+
+    return rows;
+}
+
+// Wall time at which the error of the passes in rows first reaches target,
+// interpolated on a log-log scale between passes. Negative if it never does.
+static double time_to_target(const std::vector<const converge_row *> &rows, double target)
+{
+    for(size_t i = 0; i < rows.size(); ++i) {
+        if( rows[i]->relmse > target )
+            continue;
+        if( i == 0 || rows[i]->relmse <= 0.0 )
+            return rows[i]->seconds;
+
+        const converge_row &a = *rows[i - 1], &b = *rows[i];
+        double f = std::log(target / a.relmse) / std::log(b.relmse / a.relmse);
+
+        return a.seconds * std::pow(b.seconds / a.seconds, f);
+    }
+
+    return -1.0;
+}
+
+// Passes of every candidate on the scene at the given size, in file order.
+static std::vector<std::vector<const converge_row *>> candidates(const std::vector<converge_row> &rows, const std::string &scene_name, int nx, int ny)
+{
+    std::vector<std::vector<const converge_row *>> groups;
+
+    for(const converge_row &r : rows) {
+        if( r.scene != scene_name || r.nx != nx || r.ny != ny )
+            continue;
+
+        // A new group also when a label comes back, it is a later run of it.
+        if( groups.empty() || groups.back().back()->label != r.label || r.spp <= groups.back().back()->spp )
+            groups.push_back(std::vector<const converge_row *>());
+
+        groups.back().push_back(&r);
+    }
+
+    return groups;
+}
+
+static void write_plots(std::ostream &os, const std::vector<converge_row> &rows, const std::vector<std::string> &scene_names,
+                        const converge_options &options, const std::string &output)
+{
+    os << "# Error against wall time, gnuplot " << output << ".gp writes " << output << "_<scene>.png\n"
+       << "set terminal pngcairo size 1200,500\n"
+       << "set logscale xy\n"
+       << "set xlabel 'seconds'\n"
+       << "set key bottom left\n";
+
+    int block = 0;
+
+    for(const std::string &name : scene_names) {
+        std::vector<std::vector<const converge_row *>> groups = candidates(rows, name, options.nx, options.ny);
+        int first = block;
+
+        for(const auto &g : groups) {
+            os << "$d" << block++ << " << EOD\n";
+            for(const converge_row *r : g)
+                os << r->seconds << " " << r->rmse << " " << r->relmse << "\n";
+            os << "EOD\n";
+        }
+
+        os << "set output '" << output << "_" << name << ".png'\n"
+           << "set multiplot layout 1,2 title '" << name << " " << options.nx << "x" << options.ny << "'\n";
+
+        for(int column = 2; column <= 3; ++column) {
+            os << "set ylabel '" << (column == 2 ? "RMSE" : "relMSE") << "'\n" << "plot ";
+            for(int b = first; b < block; ++b) {
+                os << (b > first ? ", " : "") << "$d" << b << " using 1:" << column << " with linespoints title '"
+                   << groups[b - first].front()->label << "'";
+            }
+            os << "\n";
+        }
+
+        os << "unset multiplot\n";
+    }
+}
+
+//
+// HARNESS
+//
+
+bool run_convergence(const scene_entry *scenes, int count, const char *filter, const converge_options &options)
+{
+    std::string output = options.output;
+    std::string csv_path = output + ".csv";
+    bool fresh = !std::ifstream(csv_path);
+    std::ofstream csv(csv_path, std::ios::app);
+
+    if( !csv ) {
+        std::cerr << "Could not write " << csv_path << "\n";
+        return false;
+    }
+
+    if( fresh )
+        csv << "label,scene,width,height,spp,seconds,rmse,relmse\n";
+
+    // The builds count in the equal time budget, they get the same threads.
+    set_thread_limit(options.render.threads);
+
+    std::vector<std::string> scene_names;
+
+    for(int i = 0; i < count; ++i) {
+        if( filter && !strstr(scenes[i].name, filter) )
+            continue;
+
+        scene the_scene;
+        the_scene.nx = options.nx;
+        the_scene.ny = options.ny;
+        the_scene.accel = options.accel;
+        the_scene.cache_dir = nullptr;
+        the_scene.seed = options.seed;
+
+        seed_drand48(the_scene.seed);
+        scenes[i].build(the_scene);
+        the_scene.world = compile_world(the_scene.world, the_scene.cam->time0, the_scene.cam->time1, the_scene.accel, nullptr);
+        the_scene.lights = make_light_sampler(the_scene.lights, the_scene.cam->time0, the_scene.cam->time1, options.render.light_sampler);
+
+        std::ostringstream path;
+        path << options.reference_dir << "/" << scenes[i].name << "_" << options.nx << "x" << options.ny
+             << "_" << options.reference_spp << "_" << options.seed << "_v" << kReferenceVersion << ".pfm";
+
+        std::vector<float> reference;
+        if( !load_reference(path.str(), options.nx, options.ny, reference) )
+            render_reference(the_scene, options, path.str(), reference);
+
+        int n = options.nx * options.ny;
+        std::vector<vec3> sum(n, vec3(0.0, 0.0, 0.0)), image(n);
+        double seconds = 0.0;
+        int spp = 0;
+
+        std::cerr << "Convergence: " << scenes[i].name << ", " << options.label << "\n";
+
+        for(int pass = 0; spp < options.max_spp; ++pass) {
+            the_scene.ns = std::max(1, std::min(spp, options.max_spp - spp));
+            seed_drand48(the_scene.seed + 1 + pass);
+
+            auto start = std::chrono::steady_clock::now();
+            render(the_scene, options.render, image.data());
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for(int p = 0; p < n; ++p)
+                sum[p] += float(the_scene.ns) * image[p];
+            spp += the_scene.ns;
+
+            double se = 0.0, rel = 0.0;
+            for(int p = 0; p < n; ++p) {
+                vec3 mean = sum[p] / float(spp);
+
+                for(int c = 0; c < 3; ++c) {
+                    double d = mean[c] - reference[3 * p + c],
+                           r = reference[3 * p + c];
+                    se += d * d;
+                    rel += d * d / (r * r + kRelMSEEpsilon);
+                }
+            }
+
+            csv << options.label << "," << scenes[i].name << "," << options.nx << "," << options.ny << "," << spp << ","
+                << seconds << "," << std::sqrt(se / (3.0 * n)) << "," << rel / (3.0 * n) << "\n";
+        }
+
+        scene_names.push_back(scenes[i].name);
+    }
+
+    csv.close();
+
+    if( scene_names.empty() ) {
+        std::cerr << "No scene matches " << filter << "\n";
+        return false;
+    }
+
+    std::vector<converge_row> rows = read_rows(csv_path);
+
+    std::ofstream plots(output + ".gp");
+    write_plots(plots, rows, scene_names, options, output);
+
+    std::ostringstream target;
+    target << "time to " << options.target;
+
+    std::cout << std::left << std::setw(20) << "scene" << std::setw(20) << "label" << std::right << std::setw(8) << "spp"
+              << std::setw(12) << "seconds" << std::setw(12) << "relMSE" << std::setw(20) << target.str() << "\n";
+
+    for(const std::string &name : scene_names) {
+        for(const auto &g : candidates(rows, name, options.nx, options.ny)) {
+            const converge_row &last = *g.back();
+            double t = time_to_target(g, options.target);
+
+            std::cout << std::left << std::setw(20) << name << std::setw(20) << last.label << std::right << std::setw(8) << last.spp
+                      << std::setw(12) << last.seconds << std::setw(12) << last.relmse << std::setw(20);
+
+            if( t >= 0.0 )
+                std::cout << t << "\n";
+            else
+                std::cout << "not reached\n";
+        }
+    }
+
+    return bool(plots);
+}
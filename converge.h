@@ -0,0 +1,28 @@
+#ifndef __CONVERGE_H__
+#define __CONVERGE_H__
+
+#include "scene.h"
+#include "render.h"
+
+struct converge_options
+{
+    int nx, ny,
+        max_spp,            // The candidate gets passes doubling its samples, 1, 2, 4..., up to this many.
+        reference_spp;
+    unsigned int seed;
+    bvh_build_method accel;
+    render_options render;  // The candidate's, references are rendered with the defaults.
+    const char *label,          // Name of the candidate in the results.
+               *reference_dir,  // Where references are kept between runs.
+               *output;         // Results appended to output.csv, plots in output.gp.
+    double target;          // relMSE whose time to reach is reported.
+};
+
+// Renders the scenes whose name contains filter against a high spp reference,
+// rendered once and cached, and appends the RMSE and relMSE of every pass to
+// the results with the wall time so far. Then prints, for every candidate in
+// the results, the time it took to reach the target error. False when no
+// scene matched or a file could not be written.
+bool run_convergence(const scene_entry *scenes, int count, const char *filter, const converge_options &options);
+
+#endif // __CONVERGE_H__
@@ -0,0 +1,119 @@
+#include "environment.h"
+#include "parallel.h"
+#include "rangen.h"
+#include "timeline.h"
+
+#include <algorithm>
+#include <cmath>
+
+environment_map::environment_map(const float *rgb, int w, int h, float scale) : width(w), height(h), texels(w * h), rows(h)
+{
+    timeline_scope span("environment", "scene");
+    span.arg("width", w);
+    span.arg("height", h);
+
+    // A row of texels spans less solid angle the closer it is to a pole.
+    parallel_for(0, h, 16, [&](int begin, int end) {
+        std::vector<float> weights(w);
+
+        for(int y = begin; y < end; ++y) {
+            float sin_theta = std::sin(kPI * (y + 0.5) / h);
+
+            for(int x = 0; x < w; ++x) {
+                const float *p = rgb + 3 * (y * w + x);
+                texels[y * w + x] = scale * vec3(p[0], p[1], p[2]);
+                weights[x] = luminance(texels[y * w + x]) * sin_theta;
+            }
+
+            rows[y] = alias_table(weights.data(), w);
+        }
+    });
+
+    std::vector<float> row_weights(h);
+    long long bytes = (long long)texels.size() * sizeof(vec3);
+
+    for(int y = 0; y < h; ++y) {
+        row_weights[y] = float(rows[y].total);
+        bytes += rows[y].bytes();
+    }
+
+    marginal = alias_table(row_weights.data(), h);
+    account_memory(memory_textures, bytes + marginal.bytes(), 0);
+}
+
+int environment_map::texel(const vec3 &direction, float &sin_theta) const
+{
+    vec3 d = unit_vector(direction);
+    float theta = std::acos(std::max(-1.0f, std::min(1.0f, d.y()))),
+          phi = std::atan2(d.z(), d.x());
+
+    int x = std::min(width - 1, int(width * (phi + kPI) / (2.0 * kPI))),
+        y = std::min(height - 1, int(height * theta / kPI));
+
+    sin_theta = std::sin(theta);
+
+    return y * width + std::max(x, 0);
+}
+
+vec3 environment_map::radiance(const vec3 &direction) const
+{
+    float sin_theta;
+    return texels[texel(direction, sin_theta)];
+}
+
+// The texels are uniform in (phi, theta), a solid angle of sin(theta) dphi dtheta.
+float environment_map::pdf_value(const vec3 &direction) const
+{
+    float sin_theta;
+    int t = texel(direction, sin_theta);
+
+    if( sin_theta <= 0.0 )
+        return 0.0;
+
+    int y = t / width,
+        x = t % width;
+
+    return marginal.pmf(y) * rows[y].pmf(x) * width * height / (2.0 * kPI * kPI * sin_theta);
+}
+
+environment_map *daylight_sky(int w, int h, float sun)
+{
+    float sun_theta = 35.0 * kPI / 180.0,
+          sun_phi = 60.0 * kPI / 180.0,
+          sun_cosine = std::cos(1.5 * kPI / 180.0);
+    vec3 to_sun(std::sin(sun_theta) * std::cos(sun_phi), std::cos(sun_theta), std::sin(sun_theta) * std::sin(sun_phi));
+    std::vector<float> rgb(3 * w * h);
+
+    for(int y = 0; y < h; ++y) {
+        float theta = kPI * (y + 0.5) / h;
+
+        for(int x = 0; x < w; ++x) {
+            float phi = 2.0 * kPI * (x + 0.5) / w - kPI;
+            vec3 d(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            vec3 c;
+
+            if( dot(d, to_sun) > sun_cosine )
+                c = sun * vec3(1.0, 0.9, 0.75);
+            else if( d.y() > 0.0 )
+                c = (1.0 - d.y()) * vec3(1.0, 1.0, 1.0) + d.y() * vec3(0.5, 0.7, 1.0);
+            else
+                c = vec3(0.3, 0.25, 0.2);
+
+            for(int k = 0; k < 3; ++k)
+                rgb[3 * (y * w + x) + k] = c[k];
+        }
+    }
+
+    return new environment_map(rgb.data(), w, h);
+}
+
+vec3 environment_map::random() const
+{
+    int y = marginal.sample(drand48());
+    int x = rows[y].sample(drand48());
+
+    float theta = kPI * (y + drand48()) / height,
+          phi = 2.0 * kPI * (x + drand48()) / width - kPI;
+
+    return vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+}
@@ -0,0 +1,49 @@
+#ifndef __ENVIRONMENT_H__
+#define __ENVIRONMENT_H__
+
+#include <vector>
+
+#include "vec3.h"
+#include "alias_table.h"
+#include "memory_stats.h"
+
+// Radiance from infinitely far away, a latitude-longitude image around the
+// y axis: rows go from +y at the top to -y, columns once around starting at
+// -x. Every texel is constant over the directions it covers.
+//
+// Directions are picked in proportion to luminance times solid angle, so a
+// few bright texels like the sun get most of the samples. A marginal
+// distribution picks the row and that row's conditional one the column,
+// both alias tables.
+class environment_map
+{
+    public:
+        RT_MEMORY_CATEGORY(memory_textures)
+
+        // w*h linear RGB values, top row first. The rows' distributions
+        // are built in parallel.
+        environment_map(const float *rgb, int w, int h, float scale = 1.0);
+
+        // Toward direction, which need not be unit length.
+        vec3 radiance(const vec3 &direction) const;
+
+        // Pdf, in solid angle, of random() returning direction.
+        float pdf_value(const vec3 &direction) const;
+        vec3 random() const;
+
+        int                         width,
+                                    height;
+        std::vector<vec3>           texels;
+        std::vector<alias_table>    rows;       // Column given the row.
+        alias_table                 marginal;   // Row.
+
+    private:
+        int texel(const vec3 &direction, float &sin_theta) const;
+};
+
+// A clear day built in code, w*h texels: white at the horizon to blue
+// overhead, a brown ground and a sun 3 degrees across, sun times brighter
+// than the horizon, 35 degrees from the zenith.
+environment_map *daylight_sky(int w = 1024, int h = 512, float sun = 2000.0);
+
+#endif // __ENVIRONMENT_H__
@@ -0,0 +1,103 @@
+#include "geometry.h"
+#include "compile.h"
+#include "parallel.h"
+#include "stats.h"
+
+#include <algorithm>
+
+const int kBatchGrain = 1024;   // Rays per task at least, below that threads cost more than they save.
+
+static inline ray batch_ray(const ray_batch &rays, int i)
+{
+    return ray(vec3(rays.org_x[i], rays.org_y[i], rays.org_z[i]),
+               vec3(rays.dir_x[i], rays.dir_y[i], rays.dir_z[i]),
+               rays.time ? rays.time[i] : 0.0);
+}
+
+geometry::geometry(hitable **l, int n, float time0, float time1, bvh_build_method method)
+{
+    world = compile_world(new hitable_list(l, n), time0, time1, method, nullptr);
+}
+
+// Consecutive rays go down as packets of up to kPacketSize. Coherent ones,
+// such as camera rays of neighbouring pixels or shadow rays from nearby
+// points toward the same light, are traced together; the BVH falls back
+// to single rays for the others.
+static int fill_packet(const ray_batch &rays, int begin, int end, ray_packet &p)
+{
+    int count = std::min(kPacketSize, end - begin);
+
+    // Packets share tmin, a run with different ones is cut short.
+    p.tmin = rays.tmin[begin];
+    for(int k = 1; k < count; ++k) {
+        if( rays.tmin[begin + k] != p.tmin ) {
+            count = k;
+            break;
+        }
+    }
+
+    for(int k = 0; k < count; ++k)
+        p.set(k, batch_ray(rays, begin + k), rays.tmax[begin + k]);
+    p.finish(count);
+
+    return count;
+}
+
+void geometry::intersect(const ray_batch &rays, hit_batch &hits) const
+{
+    parallel_for(0, rays.count, kBatchGrain, [&](int begin, int end) {
+        ray_packet p;
+        hit_record recs[kPacketSize];
+
+        for(int first = begin; first < end; ) {
+            int count = fill_packet(rays, first, end, p);
+            packet_mask hit = world->hit_packet(p, (1u << count) - 1, recs);
+
+            for(int k = 0; k < count; ++k) {
+                int i = first + k;
+                const hit_record &rec = recs[k];
+                hits.hit[i] = hit >> k & 1;
+
+                if( !hits.hit[i] )
+                    continue;
+
+                if( hits.t )
+                    hits.t[i] = rec.t;
+                if( hits.u ) {
+                    hits.u[i] = rec.u;
+                    hits.v[i] = rec.v;
+                }
+                if( hits.p_x ) {
+                    hits.p_x[i] = rec.p.x();
+                    hits.p_y[i] = rec.p.y();
+                    hits.p_z[i] = rec.p.z();
+                }
+                if( hits.normal_x ) {
+                    hits.normal_x[i] = rec.normal.x();
+                    hits.normal_y[i] = rec.normal.y();
+                    hits.normal_z[i] = rec.normal.z();
+                }
+            }
+
+            first += count;
+        }
+    });
+}
+
+void geometry::occluded(const ray_batch &rays, bool *blocked) const
+{
+    parallel_for(0, rays.count, kBatchGrain, [&](int begin, int end) {
+        ray_packet p;
+
+        for(int first = begin; first < end; ) {
+            int count = fill_packet(rays, first, end, p);
+            packet_mask b = world->occluded_packet(p, (1u << count) - 1);
+            RT_STAT_ADD(rays[stat_ray_shadow], count);
+
+            for(int k = 0; k < count; ++k)
+                blocked[first + k] = b >> k & 1;
+
+            first += count;
+        }
+    });
+}
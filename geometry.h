@@ -0,0 +1,51 @@
+#ifndef __GEOMETRY_H__
+#define __GEOMETRY_H__
+
+#include "hitables.h"
+#include "bvh_node.h"
+
+// Rays as a structure of arrays, for tools that trace millions at once. The
+// arrays belong to the caller. time may be null, then every ray is at time 0.
+struct ray_batch
+{
+    const float *org_x, *org_y, *org_z,
+                *dir_x, *dir_y, *dir_z,
+                *tmin,
+                *tmax,
+                *time;
+    int         count;
+};
+
+// Closest hit of every ray of a batch. hit is required, any other array may
+// be null to skip it; u and v, the p and the normal arrays go together.
+// Nothing but hit is written for rays that miss.
+struct hit_batch
+{
+    bool    *hit;
+    float   *t,
+            *u, *v,
+            *p_x, *p_y, *p_z,
+            *normal_x, *normal_y, *normal_z;
+};
+
+typedef ray_batch RayBatch;
+typedef hit_batch HitBatch;
+
+// The geometry core on its own, no camera or materials: primitives may have
+// null materials. Batches are traced on every core, neighbouring rays as
+// packets: keep coherent rays next to each other in the arrays.
+class geometry
+{
+    public:
+        // Compiles the primitives into the accelerators the renderer uses.
+        geometry(hitable **l, int n, float time0 = 0.0, float time1 = 1.0, bvh_build_method method = bvh_sah);
+        // Wraps an already compiled world.
+        explicit geometry(hitable *w) : world(w) {}
+
+        void intersect(const ray_batch &rays, hit_batch &hits) const;
+        void occluded(const ray_batch &rays, bool *blocked) const;
+
+        hitable *world;
+};
+
+#endif // __GEOMETRY_H__
@@ -0,0 +1,63 @@
+#include "heatmap.h"
+#include "image_io.h"
+
+#include <algorithm>
+#include <fstream>
+
+// Black through purple and orange to pale yellow, dark meaning cheap.
+static void false_colour(float t, unsigned char *rgb)
+{
+    static const float stops[5][3] = {
+        {   0.0f,   0.0f,   4.0f },
+        {  87.0f,  16.0f, 110.0f },
+        { 188.0f,  55.0f,  84.0f },
+        { 249.0f, 142.0f,   9.0f },
+        { 252.0f, 255.0f, 164.0f }
+    };
+
+    t = std::min(std::max(t, 0.0f), 1.0f) * 4.0f;
+    int k = std::min(int(t), 3);
+    float f = t - k;
+
+    for(int c = 0; c < 3; ++c)
+        rgb[c] = (unsigned char)(stops[k][c] + f * (stops[k + 1][c] - stops[k][c]) + 0.5f);
+}
+
+bool write_heatmap(const std::string &base, const float *heat, int nx, int ny, const std::vector<tile_record> &tiles)
+{
+    int n = nx * ny;
+    bool ok = write_pfm((base + ".heat.pfm").c_str(), heat, nx, ny);
+
+    // A few very expensive pixels would leave the rest black with the maximum.
+    std::vector<float> sorted(heat, heat + n);
+    std::nth_element(sorted.begin(), sorted.begin() + (n - 1) * 99 / 100, sorted.end());
+    float scale = sorted[(n - 1) * 99 / 100];
+    scale = scale > 0.0f ? 1.0f / scale : 0.0f;
+
+    std::vector<unsigned char> rgb(3 * size_t(n));
+    for(int i = 0; i < n; ++i)
+        false_colour(heat[i] * scale, &rgb[3 * size_t(i)]);
+
+    ok = write_png((base + ".heat.png").c_str(), rgb.data(), nx, ny) && ok;
+
+    std::ofstream csv(base + ".tiles.csv");
+    csv << "x0,y0,x1,y1,thread,start_ms,end_ms,cost_sum,cost_mean,cost_max\n";
+
+    for(const tile_record &t : tiles) {
+        double sum = 0.0;
+        float max = 0.0f;
+
+        for(int j = t.y0; j < t.y1; ++j) {
+            for(int i = t.x0; i < t.x1; ++i) {
+                sum += heat[j * nx + i];
+                max = std::max(max, heat[j * nx + i]);
+            }
+        }
+
+        csv << t.x0 << "," << t.y0 << "," << t.x1 << "," << t.y1 << "," << t.thread << ","
+            << t.start * 1000.0 << "," << t.end * 1000.0 << ","
+            << sum << "," << sum / ((t.x1 - t.x0) * (t.y1 - t.y0)) << "," << max << "\n";
+    }
+
+    return bool(csv) && ok;
+}
@@ -0,0 +1,14 @@
+#ifndef __HEATMAP_H__
+#define __HEATMAP_H__
+
+#include <string>
+#include <vector>
+
+#include "render.h"
+
+// Writes the per pixel cost of a render as base.heat.pfm, a false colour
+// base.heat.png scaled to the 99th percentile, and base.tiles.csv with the
+// cost, thread and timing of every tile. False if a file failed.
+bool write_heatmap(const std::string &base, const float *heat, int nx, int ny, const std::vector<tile_record> &tiles);
+
+#endif // __HEATMAP_H__
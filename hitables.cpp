@@ -1,6 +1,52 @@
 #include "hitables.h"
+#include "materials.h"
+#include "stats.h"
+#include "rangen.h"
+#include "onb.h"
 
-const double kPI = 3.141592653589793;
+#include <float.h>
+
+// Of a diffuse emitter of the given area, from its emission averaged over
+// the texture. Textures that depend on the point are taken at p.
+static float emitter_power(const material *m, float area, const vec3 &p)
+{
+    return m ? kPI * area * luminance(m->average_emitted(p)) : 0.0;
+}
+
+bool hitable::slab_bounding_box(float t0, float t1, int axis, float lo, float hi, aabb &box) const
+{
+    if( !bounding_box(t0, t1, box) )
+        return false;
+    
+    box._min[axis] = ffmax(box._min[axis], lo);
+    box._max[axis] = ffmin(box._max[axis], hi);
+    
+    return true;
+}
+
+packet_mask hitable::hit_packet(ray_packet &p, packet_mask mask, hit_record *recs) const
+{
+    packet_mask hits = 0;
+    
+    for(int i = 0; i < p.size; ++i) {
+        if( (mask >> i & 1) && hit(p.get(i), p.tmin, p.tmax[i], recs[i]) ) {
+            p.tmax[i] = recs[i].t;
+            hits |= 1u << i;
+        }
+    }
+    return hits;
+}
+
+packet_mask hitable::occluded_packet(const ray_packet &p, packet_mask mask) const
+{
+    packet_mask blocked = 0;
+    
+    for(int i = 0; i < p.size; ++i) {
+        if( (mask >> i & 1) && occluded(p.get(i), p.tmin, p.tmax[i]) )
+            blocked |= 1u << i;
+    }
+    return blocked;
+}
 
 //
 // HITABLE LIST
@@ -13,6 +59,7 @@ bool hitable_list::hit(const ray &r, float tmin, float tmax, hit_record &rec) co
     double closest_so_far = tmax;
     
     for(int i = 0; i < list_size; ++i) {
+        RT_STAT(prim_tests);
         if(list[i]->hit(r, tmin, closest_so_far, temp_rec)) {
             hit_anything = true;
             closest_so_far = temp_rec.t;
@@ -22,6 +69,40 @@ bool hitable_list::hit(const ray &r, float tmin, float tmax, hit_record &rec) co
     return hit_anything;
 }
 
+bool hitable_list::occluded(const ray &r, float tmin, float tmax) const
+{
+    for(int i = 0; i < list_size; ++i) {
+        RT_STAT(prim_tests);
+        if(list[i]->occluded(r, tmin, tmax))
+            return true;
+    }
+    return false;
+}
+
+packet_mask hitable_list::hit_packet(ray_packet &p, packet_mask mask, hit_record *recs) const
+{
+    packet_mask hits = 0;
+    
+    for(int i = 0; i < list_size; ++i) {
+        RT_STAT(prim_tests);
+        hits |= list[i]->hit_packet(p, mask, recs);
+    }
+    return hits;
+}
+
+packet_mask hitable_list::occluded_packet(const ray_packet &p, packet_mask mask) const
+{
+    packet_mask blocked = 0;
+    
+    for(int i = 0; i < list_size && mask; ++i) {
+        RT_STAT(prim_tests);
+        packet_mask b = list[i]->occluded_packet(p, mask);
+        blocked |= b;
+        mask &= ~b;
+    }
+    return blocked;
+}
+
 bool hitable_list::bounding_box(float t0, float t1, aabb &box) const
 {
     if (list_size < 1) return false;
@@ -35,7 +116,7 @@ bool hitable_list::bounding_box(float t0, float t1, aabb &box) const
         box = temp_box;
 
     for (int i = 1; i < list_size; ++i) {
-        if(list[0]->bounding_box(t0, t1, temp_box)) {
+        if(list[i]->bounding_box(t0, t1, temp_box)) {
             box = surrounding(box, temp_box);
         }
         else
@@ -45,6 +126,23 @@ bool hitable_list::bounding_box(float t0, float t1, aabb &box) const
     return true;
 }
 
+float hitable_list::pdf_value(const vec3 &o, const vec3 &v) const
+{
+    float sum = 0.0;
+    
+    for(int i = 0; i < list_size; ++i)
+        sum += list[i]->pdf_value(o, v);
+    
+    return list_size > 0 ? sum / list_size : 0.0;
+}
+
+vec3 hitable_list::random(const vec3 &o) const
+{
+    int i = int(drand48() * list_size);
+    
+    return list[i < list_size ? i : list_size - 1]->random(o);
+}
+
 //
 // SPHERE
 //
@@ -58,6 +156,7 @@ void get_sphere_uv(const vec3 &p, float &u, float &v) {
 
 bool sphere::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
 {
+    RT_STAT(prim_class_tests[stat_sphere]);
     vec3 oc = r.origin() - center;
     
     float a = dot(r.direction(), r.direction());
@@ -95,18 +194,185 @@ bool sphere::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
     return false;
 }
 
+bool sphere::occluded(const ray &r, float tmin, float tmax) const
+{
+    RT_STAT(prim_class_tests[stat_sphere]);
+    vec3 oc = r.origin() - center;
+    
+    float a = dot(r.direction(), r.direction());
+    float b = 2.0 * dot(oc, r.direction());
+    float c = dot(oc, oc) - radius * radius;
+    
+    float discriminant = b * b - 4.0 * a * c;
+    
+    if( discriminant <= 0.0 )
+        return false;
+    
+    float temp = (-b - sqrt(discriminant)) / (2.0 * a);
+    if( temp < tmax && temp > tmin )
+        return true;
+    
+    temp = (-b + sqrt(discriminant)) / (2.0 * a);
+    return temp < tmax && temp > tmin;
+}
+
 bool sphere::bounding_box(float t0, float t1, aabb &box) const
 {
     box = aabb(center - vec3(radius, radius, radius), center + vec3(radius, radius, radius));
     return true;
 }
 
+// The slab cuts a lens out of the sphere, as wide as its section nearest the center.
+bool sphere::slab_bounding_box(float t0, float t1, int axis, float lo, float hi, aabb &box) const
+{
+    float r = fabs(radius);
+    float c = center[axis];
+    float slab_lo = ffmax(lo, c - r);
+    float slab_hi = ffmin(hi, c + r);
+    float d = c < slab_lo ? slab_lo - c : (c > slab_hi ? c - slab_hi : 0.0);
+    float section = d < r ? sqrt(r * r - d * d) : 0.0;
+    
+    box = aabb(center - vec3(section, section, section), center + vec3(section, section, section));
+    box._min[axis] = slab_lo;
+    box._max[axis] = slab_hi;
+    
+    return true;
+}
+
+// The hit() test on four lanes at once. Writes t of the lanes in mask that hit and returns them.
+static packet_mask sphere_lanes(const vec3 &center, float radius, const ray_packet &p, packet_mask mask, float *t)
+{
+    packet_mask hits = 0;
+    float4 zero(0.0f),
+           tmin(p.tmin);
+    
+    for(int g = 0; g < p.size; g += 4) {
+        if( !((mask >> g) & 15) )
+            continue;
+        
+        float4 ocx = float4::load(p.org[0] + g) - float4(center.x()),
+               ocy = float4::load(p.org[1] + g) - float4(center.y()),
+               ocz = float4::load(p.org[2] + g) - float4(center.z());
+        float4 dx = float4::load(p.dir[0] + g),
+               dy = float4::load(p.dir[1] + g),
+               dz = float4::load(p.dir[2] + g);
+        
+        float4 a = dx * dx + dy * dy + dz * dz;
+        float4 b = float4(2.0f) * (ocx * dx + ocy * dy + ocz * dz);
+        float4 c = ocx * ocx + ocy * ocy + ocz * ocz - float4(radius * radius);
+        float4 discriminant = b * b - float4(4.0f) * a * c;
+        float4 root = sqrt4(max4(discriminant, zero));
+        float4 two_a = float4(2.0f) * a;
+        float4 t0 = (zero - b - root) / two_a,
+               t1 = (zero - b + root) / two_a;
+        float4 tmax = float4::load(p.tmax + g);
+        
+        packet_mask real = less4(zero, discriminant);
+        packet_mask near_hit = real & less4(tmin, t0) & less4(t0, tmax);
+        packet_mask far_hit = real & less4(tmin, t1) & less4(t1, tmax);
+        packet_mask lanes = (near_hit | far_hit) & (mask >> g) & 15;
+        
+        if( !lanes )
+            continue;
+        
+        alignas(16) float near_t[4], far_t[4];
+        t0.store(near_t);
+        t1.store(far_t);
+        
+        for(int i = 0; i < 4; ++i) {
+            if( lanes >> i & 1 )
+                t[g + i] = (near_hit >> i & 1) ? near_t[i] : far_t[i];
+        }
+        hits |= lanes << g;
+    }
+    return hits;
+}
+
+packet_mask sphere::hit_packet(ray_packet &p, packet_mask mask, hit_record *recs) const
+{
+    RT_STAT_ADD(prim_class_tests[stat_sphere], lane_count(mask));
+    float t[kPacketSize];
+    packet_mask hits = sphere_lanes(center, radius, p, mask, t);
+    
+    for(int i = 0; i < p.size; ++i) {
+        if( !(hits >> i & 1) )
+            continue;
+        
+        hit_record &rec = recs[i];
+        rec.t = t[i];
+        rec.p = vec3(p.org[0][i], p.org[1][i], p.org[2][i]) + t[i] * vec3(p.dir[0][i], p.dir[1][i], p.dir[2][i]);
+        get_sphere_uv((rec.p-center)/radius, rec.u, rec.v);
+        rec.normal = (rec.p - center) / radius;
+        rec.mat_ptr = this->mat_ptr;
+        p.tmax[i] = t[i];
+    }
+    return hits;
+}
+
+packet_mask sphere::occluded_packet(const ray_packet &p, packet_mask mask) const
+{
+    RT_STAT_ADD(prim_class_tests[stat_sphere], lane_count(mask));
+    float t[kPacketSize];
+    return sphere_lanes(center, radius, p, mask, t);
+}
+
+float sphere::pdf_value(const vec3 &o, const vec3 &v) const
+{
+    hit_record rec;
+    float distance_squared = (center - o).squared_length();
+    
+    if( distance_squared <= radius * radius || !hit(ray(o, v), 0.001, FLT_MAX, rec) )
+        return 0.0;
+    
+    float cos_theta_max = sqrt(1.0 - radius * radius / distance_squared);
+    
+    return 1.0 / (2.0 * kPI * (1.0 - cos_theta_max));
+}
+
+vec3 sphere::random(const vec3 &o) const
+{
+    vec3 direction = center - o;
+    float distance_squared = direction.squared_length();
+    
+    if( distance_squared <= radius * radius )
+        return direction;
+    
+    float cos_theta_max = sqrt(1.0 - radius * radius / distance_squared);
+    float z = 1.0 + drand48() * (cos_theta_max - 1.0);
+    float phi = 2.0 * kPI * drand48();
+    float sin_theta = sqrt(1.0 - z * z);
+    
+    return onb(direction).local(cos(phi) * sin_theta, sin(phi) * sin_theta, z);
+}
+
+float sphere::power() const
+{
+    return emitter_power(mat_ptr, 4.0 * kPI * radius * radius, center);
+}
+
+bool sphere::random_point(hit_record &rec, float &area) const
+{
+    float z = 1.0 - 2.0 * drand48();
+    float phi = 2.0 * kPI * drand48();
+    float r = sqrt(std::max(0.0f, 1.0f - z * z));
+    
+    rec.normal = vec3(r * cos(phi), r * sin(phi), z);
+    rec.p = center + radius * rec.normal;
+    rec.t = 0.0;
+    rec.mat_ptr = mat_ptr;
+    get_sphere_uv(rec.normal, rec.u, rec.v);
+    area = 4.0 * kPI * radius * radius;
+    
+    return true;
+}
+
 //
 // MOVING SPHERE
 //
 
 bool moving_sphere::hit(const ray& r, float tmin, float tmax, hit_record& rec) const
 {
+    RT_STAT(prim_class_tests[stat_moving_sphere]);
     vec3 oc = r.origin() - center(r.time());
     
     float a = dot(r.direction(), r.direction());
@@ -142,6 +408,28 @@ bool moving_sphere::hit(const ray& r, float tmin, float tmax, hit_record& rec) c
     return false;
 }
 
+bool moving_sphere::occluded(const ray &r, float tmin, float tmax) const
+{
+    RT_STAT(prim_class_tests[stat_moving_sphere]);
+    vec3 oc = r.origin() - center(r.time());
+    
+    float a = dot(r.direction(), r.direction());
+    float b = 2.0 * dot(oc, r.direction());
+    float c = dot(oc, oc) - radius * radius;
+    
+    float discriminant = b * b - 4.0 * a * c;
+    
+    if( discriminant <= 0.0 )
+        return false;
+    
+    float temp = (-b - sqrt(discriminant)) / (2.0 * a);
+    if( temp < tmax && temp > tmin )
+        return true;
+    
+    temp = (-b + sqrt(discriminant)) / (2.0 * a);
+    return temp < tmax && temp > tmin;
+}
+
 vec3 moving_sphere::center(float time) const
 {
     return center0 + ((time - time0) / (time1 - time0)) * (center1 - center0);
@@ -161,8 +449,19 @@ bool moving_sphere::bounding_box(float t0, float t1, aabb &box) const
 // RECTANGLES
 //
 
+// Density per unit solid angle, seen from the origin of r, of a point taken
+// uniformly from a rectangle of the given area that r hits at rec.
+static float rect_pdf(const ray &r, const hit_record &rec, float area)
+{
+    float distance_squared = rec.t * rec.t * r.direction().squared_length();
+    float cosine = fabs(dot(r.direction(), rec.normal)) / r.direction().length();
+    
+    return distance_squared / (cosine * area);
+}
+
 bool rect_xy::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
 {
+    RT_STAT(prim_class_tests[stat_rect]);
     float t = (k - r.origin().z()) / r.direction().z();
     
     if( t < tmin || t > tmax)
@@ -184,8 +483,58 @@ bool rect_xy::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
     return true;
 }
 
+bool rect_xy::occluded(const ray &r, float tmin, float tmax) const
+{
+    RT_STAT(prim_class_tests[stat_rect]);
+    float t = (k - r.origin().z()) / r.direction().z();
+    
+    if( t < tmin || t > tmax)
+        return false;
+        
+    float x = r.origin().x() + t * r.direction().x();
+    float y = r.origin().y() + t * r.direction().y();
+    
+    return x >= x0 && x <= x1 && y >= y0 && y <= y1;
+}
+
+float rect_xy::pdf_value(const vec3 &o, const vec3 &v) const
+{
+    hit_record rec;
+    ray r(o, v);
+    
+    if( !hit(r, 0.001, FLT_MAX, rec) )
+        return 0.0;
+    
+    return rect_pdf(r, rec, (x1 - x0) * (y1 - y0));
+}
+
+vec3 rect_xy::random(const vec3 &o) const
+{
+    return vec3(x0 + drand48() * (x1 - x0), y0 + drand48() * (y1 - y0), k) - o;
+}
+
+// Both faces emit.
+float rect_xy::power() const
+{
+    return emitter_power(mp, 2.0 * (x1 - x0) * (y1 - y0), vec3(0.5 * (x0 + x1), 0.5 * (y0 + y1), k));
+}
+
+bool rect_xy::random_point(hit_record &rec, float &area) const
+{
+    rec.u = drand48();
+    rec.v = drand48();
+    rec.t = 0.0;
+    rec.mat_ptr = mp;
+    rec.p = vec3(x0 + rec.u * (x1 - x0), y0 + rec.v * (y1 - y0), k);
+    rec.normal = vec3(0.0, 0.0, 1.0);
+    area = (x1 - x0) * (y1 - y0);
+    
+    return true;
+}
+
 bool rect_xz::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
 {
+    RT_STAT(prim_class_tests[stat_rect]);
     float t = (k - r.origin().y()) / r.direction().y();
     
     if( t < tmin || t > tmax)
@@ -207,8 +556,57 @@ bool rect_xz::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
     return true;
 }
 
+bool rect_xz::occluded(const ray &r, float tmin, float tmax) const
+{
+    RT_STAT(prim_class_tests[stat_rect]);
+    float t = (k - r.origin().y()) / r.direction().y();
+    
+    if( t < tmin || t > tmax)
+        return false;
+        
+    float x = r.origin().x() + t * r.direction().x();
+    float z = r.origin().z() + t * r.direction().z();
+    
+    return x >= x0 && x <= x1 && z >= z0 && z <= z1;
+}
+
+float rect_xz::pdf_value(const vec3 &o, const vec3 &v) const
+{
+    hit_record rec;
+    ray r(o, v);
+    
+    if( !hit(r, 0.001, FLT_MAX, rec) )
+        return 0.0;
+    
+    return rect_pdf(r, rec, (x1 - x0) * (z1 - z0));
+}
+
+vec3 rect_xz::random(const vec3 &o) const
+{
+    return vec3(x0 + drand48() * (x1 - x0), k, z0 + drand48() * (z1 - z0)) - o;
+}
+
+float rect_xz::power() const
+{
+    return emitter_power(mp, 2.0 * (x1 - x0) * (z1 - z0), vec3(0.5 * (x0 + x1), k, 0.5 * (z0 + z1)));
+}
+
+bool rect_xz::random_point(hit_record &rec, float &area) const
+{
+    rec.u = drand48();
+    rec.v = drand48();
+    rec.t = 0.0;
+    rec.mat_ptr = mp;
+    rec.p = vec3(x0 + rec.u * (x1 - x0), k, z0 + rec.v * (z1 - z0));
+    rec.normal = vec3(0.0, 1.0, 0.0);
+    area = (x1 - x0) * (z1 - z0);
+    
+    return true;
+}
+
 bool rect_yz::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
 {
+    RT_STAT(prim_class_tests[stat_rect]);
     float t = (k - r.origin().x()) / r.direction().x();
     
     if( t < tmin || t > tmax)
@@ -230,6 +628,101 @@ bool rect_yz::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
     return true;
 }
 
+bool rect_yz::occluded(const ray &r, float tmin, float tmax) const
+{
+    RT_STAT(prim_class_tests[stat_rect]);
+    float t = (k - r.origin().x()) / r.direction().x();
+    
+    if( t < tmin || t > tmax)
+        return false;
+        
+    float y = r.origin().y() + t * r.direction().y();
+    float z = r.origin().z() + t * r.direction().z();
+    
+    return y >= y0 && y <= y1 && z >= z0 && z <= z1;
+}
+
+float rect_yz::pdf_value(const vec3 &o, const vec3 &v) const
+{
+    hit_record rec;
+    ray r(o, v);
+    
+    if( !hit(r, 0.001, FLT_MAX, rec) )
+        return 0.0;
+    
+    return rect_pdf(r, rec, (y1 - y0) * (z1 - z0));
+}
+
+vec3 rect_yz::random(const vec3 &o) const
+{
+    return vec3(k, y0 + drand48() * (y1 - y0), z0 + drand48() * (z1 - z0)) - o;
+}
+
+float rect_yz::power() const
+{
+    return emitter_power(mp, 2.0 * (y1 - y0) * (z1 - z0), vec3(k, 0.5 * (y0 + y1), 0.5 * (z0 + z1)));
+}
+
+bool rect_yz::random_point(hit_record &rec, float &area) const
+{
+    rec.u = drand48();
+    rec.v = drand48();
+    rec.t = 0.0;
+    rec.mat_ptr = mp;
+    rec.p = vec3(k, y0 + rec.u * (y1 - y0), z0 + rec.v * (z1 - z0));
+    rec.normal = vec3(1.0, 0.0, 0.0);
+    area = (y1 - y0) * (z1 - z0);
+    
+    return true;
+}
+
+//
+// PLANE
+//
+
+plane::plane(const vec3 &p, const vec3 &n, material *m) : point(p), normal(unit_vector(n)), mat_ptr(m)
+{
+    vec3 a = fabs(normal.x()) > 0.9 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    u_axis = unit_vector(cross(a, normal));
+    v_axis = cross(normal, u_axis);
+}
+
+bool plane::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
+{
+    RT_STAT(prim_class_tests[stat_plane]);
+    float denom = dot(normal, r.direction());
+    
+    if( denom == 0.0 )
+        return false;
+    
+    float t = dot(point - r.origin(), normal) / denom;
+    
+    if( t < tmin || t > tmax )
+        return false;
+    
+    rec.t = t;
+    rec.p = r.point_at_parameter(t);
+    rec.u = dot(rec.p - point, u_axis);
+    rec.v = dot(rec.p - point, v_axis);
+    rec.normal = normal;
+    rec.mat_ptr = mat_ptr;
+    
+    return true;
+}
+
+bool plane::occluded(const ray &r, float tmin, float tmax) const
+{
+    RT_STAT(prim_class_tests[stat_plane]);
+    float denom = dot(normal, r.direction());
+    
+    if( denom == 0.0 )
+        return false;
+    
+    float t = dot(point - r.origin(), normal) / denom;
+    
+    return t >= tmin && t <= tmax;
+}
+
 //
 // BOX
 //
@@ -252,7 +745,14 @@ box::box(const vec3 &p0, const vec3 &p1, material *mat_ptr)
 
 bool box::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
 {
+    RT_STAT(prim_class_tests[stat_box]);
     return list_ptr->hit(r, tmin, tmax, rec);
 }
 
+bool box::occluded(const ray &r, float tmin, float tmax) const
+{
+    RT_STAT(prim_class_tests[stat_box]);
+    return list_ptr->occluded(r, tmin, tmax);
+}
+
 
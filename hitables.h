@@ -3,6 +3,9 @@
 
 #include "ray.h"
 #include "aabb.h"
+#include "packet.h"
+#include "stats.h"
+#include "memory_stats.h"
 
 class material;
 
@@ -19,18 +22,72 @@ struct hit_record
 class hitable
 {
     public:
+        RT_MEMORY_CATEGORY(memory_primitives)
+        
         virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const = 0;
         virtual bool bounding_box(float t0, float t1, aabb &box) const = 0;
+        
+        // Any hit in (tmin, tmax), for shadow and visibility rays. Stops at the
+        // first one found and fills nothing. The default just calls hit().
+        virtual bool occluded(const ray &r, float tmin, float tmax) const
+        {
+            hit_record rec;
+            return hit(r, tmin, tmax, rec);
+        }
+        
+        // Whether a BVH may reference the primitive from more than one leaf.
+        // Not for those whose hit() is random, they must be tested once per ray.
+        virtual bool splittable() const { return true; }
+        
+        // Bounds of the part of the primitive with lo <= p[axis] <= hi, for the
+        // spatial split builder. By default the clipped bounding box.
+        virtual bool slab_bounding_box(float t0, float t1, int axis, float lo, float hi, aabb &box) const;
+        
+        // hit() and occluded() for the lanes of a packet in mask. hit_packet()
+        // fills recs and shrinks tmax of the lanes it hits and returns them,
+        // occluded_packet() returns the blocked ones. By default a ray at a time.
+        virtual packet_mask hit_packet(ray_packet &p, packet_mask mask, hit_record *recs) const;
+        virtual packet_mask occluded_packet(const ray_packet &p, packet_mask mask) const;
+        
+        // Light sampling. random() returns a direction from o toward a random
+        // point of the primitive, pdf_value() the density per unit solid angle
+        // with which it returns direction v. Only for the primitives that can
+        // be sampled as lights, the others have density 0.
+        virtual float pdf_value(const vec3 &o, const vec3 &v) const { return 0.0; }
+        virtual vec3 random(const vec3 &o) const { return vec3(1.0, 0.0, 0.0); }
+        
+        // Luminous power the primitive radiates, to pick among lights. 0 for
+        // those that do not emit and those that can not be sampled.
+        virtual float power() const { return 0.0; }
+        
+        // A point spread evenly over the surface, with what hit() would record
+        // there, and the area of the surface. For starting light paths, false
+        // for the primitives that can not.
+        virtual bool random_point(hit_record &rec, float &area) const { return false; }
 };
 
 class hitable_list : public hitable
 {
     public:
+        RT_MEMORY_CATEGORY(memory_instances)
+        
         hitable_list() {}
-        hitable_list(hitable **l, int n) { list = l; list_size = n; }
+        hitable_list(hitable **l, int n)
+        {
+            list = l;
+            list_size = n;
+            account_memory(memory_instances, (long long)n * sizeof(hitable *), 0);
+        }
         
         virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
         virtual bool bounding_box(float t0, float t1, aabb &box) const;
+        virtual packet_mask hit_packet(ray_packet &p, packet_mask mask, hit_record *recs) const;
+        virtual packet_mask occluded_packet(const ray_packet &p, packet_mask mask) const;
+        
+        // A member picked at random, all with the same probability.
+        virtual float pdf_value(const vec3 &o, const vec3 &v) const;
+        virtual vec3 random(const vec3 &o) const;
         
         hitable **list;
         int list_size;
@@ -47,7 +104,17 @@ class sphere : public hitable
         sphere(vec3 cen, float r, material *mp) : center(cen), radius(r), mat_ptr(mp) {}
         
         virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
         virtual bool bounding_box(float t0, float t1, aabb &box) const;
+        virtual bool slab_bounding_box(float t0, float t1, int axis, float lo, float hi, aabb &box) const;
+        virtual packet_mask hit_packet(ray_packet &p, packet_mask mask, hit_record *recs) const;
+        virtual packet_mask occluded_packet(const ray_packet &p, packet_mask mask) const;
+        
+        // Uniform over the cone the sphere subtends from o, none from inside.
+        virtual float pdf_value(const vec3 &o, const vec3 &v) const;
+        virtual vec3 random(const vec3 &o) const;
+        virtual float power() const;
+        virtual bool random_point(hit_record &rec, float &area) const;
         
         vec3    center;
         float   radius;
@@ -66,6 +133,7 @@ class moving_sphere : public hitable
             center0(c0), center1(c1), time0(t0), time1(t1), radius(r), mat_ptr(m) {}
     
         virtual bool hit(const ray& r, float tmin, float tmax, hit_record& rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
         virtual bool bounding_box(float t0, float t1, aabb &box) const;
         
         vec3    center(float time) const;
@@ -88,11 +156,16 @@ class rect_xy : public hitable
             x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mp(_mp) {}
             
         virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
         virtual bool bounding_box(float t0, float t1, aabb &box) const
         {
             box = aabb(vec3(x0, y0, k-0.0001), vec3(x1, y1, k+0.0001));
             return true;
         }
+        virtual float pdf_value(const vec3 &o, const vec3 &v) const;
+        virtual vec3 random(const vec3 &o) const;
+        virtual float power() const;
+        virtual bool random_point(hit_record &rec, float &area) const;
                 
         float x0, x1, y0, y1, k;
         material *mp;
@@ -106,11 +179,16 @@ class rect_xz : public hitable
             x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mp(_mp) {}
             
         virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
         virtual bool bounding_box(float t0, float t1, aabb &box) const
         {
             box = aabb(vec3(x0, k-0.0001, z0), vec3(x1, k+0.0001, z1));
             return true;
         }
+        virtual float pdf_value(const vec3 &o, const vec3 &v) const;
+        virtual vec3 random(const vec3 &o) const;
+        virtual float power() const;
+        virtual bool random_point(hit_record &rec, float &area) const;
         
         float x0, x1, z0, z1, k;
         material *mp;
@@ -124,16 +202,44 @@ class rect_yz : public hitable
             y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mp(_mp) {}
             
         virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
         virtual bool bounding_box(float t0, float t1, aabb &box) const
         {
             box = aabb(vec3(k-0.0001, y0, z0), vec3(k+0.0001, y1, z1));
             return true;
         }
+        virtual float pdf_value(const vec3 &o, const vec3 &v) const;
+        virtual vec3 random(const vec3 &o) const;
+        virtual float power() const;
+        virtual bool random_point(hit_record &rec, float &area) const;
         
         float y0, y1, z0, z1, k;
         material *mp;
 };
 
+//
+// PLANE
+//
+
+// Infinite plane through 'point'. It has no bounding box, so the scene
+// compiler keeps it out of the BVH. u and v are distances along the plane.
+class plane : public hitable
+{
+    public:
+        plane() {}
+        plane(const vec3 &p, const vec3 &n, material *m);
+        
+        virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
+        virtual bool bounding_box(float t0, float t1, aabb &box) const { return false; }
+        
+        vec3    point,
+                normal,
+                u_axis,
+                v_axis;
+        material *mat_ptr;
+};
+
 //
 // FLIP NORMALS
 //
@@ -141,9 +247,12 @@ class rect_yz : public hitable
 class flip_normals : public hitable
 {
     public:
+        RT_MEMORY_CATEGORY(memory_instances)
+        
         flip_normals(hitable *p) : ptr(p) {}
         virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const
         {
+            RT_STAT(prim_class_tests[stat_instance]);
             if(ptr->hit(r, tmin, tmax, rec)) {
                 rec.normal = -rec.normal;
                 return true;
@@ -152,10 +261,26 @@ class flip_normals : public hitable
                 return false;
             }
         }
+        virtual bool occluded(const ray &r, float tmin, float tmax) const
+        {
+            RT_STAT(prim_class_tests[stat_instance]);
+            return ptr->occluded(r, tmin, tmax);
+        }
         virtual bool bounding_box(float t0, float t1, aabb &box) const
         {
             return ptr->bounding_box(t0, t1, box);
         }
+        virtual bool splittable() const { return ptr->splittable(); }
+        virtual float pdf_value(const vec3 &o, const vec3 &v) const { return ptr->pdf_value(o, v); }
+        virtual vec3 random(const vec3 &o) const { return ptr->random(o); }
+        virtual float power() const { return ptr->power(); }
+        virtual bool random_point(hit_record &rec, float &area) const
+        {
+            if( !ptr->random_point(rec, area) )
+                return false;
+            rec.normal = -rec.normal;
+            return true;
+        }
   
     hitable *ptr;
 };
@@ -170,6 +295,7 @@ class box : public hitable
         box();
         box(const vec3 &p0, const vec3 &p1, material *mat_ptr);
         virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
         virtual bool bounding_box(float t0, float t1, aabb &box) const 
         {
             box = aabb(pmin, pmax);
@@ -0,0 +1,161 @@
+#include "image_io.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+static bool little_endian()
+{
+    uint16_t probe = 1;
+    return *reinterpret_cast<unsigned char *>(&probe) == 1;
+}
+
+bool write_pfm(const char *path, const float *values, int width, int height, int channels)
+{
+    std::ofstream file(path, std::ios::binary);
+
+    if( !file )
+        return false;
+
+    // A negative scale means little endian. PFM rows go bottom first too.
+    file << (channels == 3 ? "PF" : "Pf") << "\n" << width << " " << height << "\n" << (little_endian() ? "-1.0" : "1.0") << "\n";
+    file.write(reinterpret_cast<const char *>(values), sizeof(float) * width * height * channels);
+
+    return bool(file);
+}
+
+bool read_pfm(const char *path, std::vector<float> &values, int &width, int &height, int &channels)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string type;
+    float scale;
+
+    if( !(file >> type >> width >> height >> scale) || (type != "PF" && type != "Pf") || width <= 0 || height <= 0 )
+        return false;
+
+    file.get();
+    channels = type == "PF" ? 3 : 1;
+    values.resize(size_t(width) * height * channels);
+    file.read(reinterpret_cast<char *>(values.data()), sizeof(float) * values.size());
+
+    if( !file )
+        return false;
+
+    if( (scale < 0.0f) != little_endian() ) {
+        for(float &v : values) {
+            char *b = reinterpret_cast<char *>(&v);
+            std::reverse(b, b + 4);
+        }
+    }
+
+    return true;
+}
+
+//
+// PNG
+//
+
+static uint32_t crc32(const unsigned char *data, size_t n, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static bool ready = false;
+
+    if( !ready ) {
+        for(uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for(int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        ready = true;
+    }
+
+    crc = ~crc;
+    for(size_t i = 0; i < n; ++i)
+        crc = table[(crc ^ data[i]) & 255] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+static void put32(std::vector<unsigned char> &out, uint32_t v)
+{
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+static void write_chunk(std::ofstream &file, const char *type, const std::vector<unsigned char> &data)
+{
+    std::vector<unsigned char> chunk;
+    put32(chunk, uint32_t(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    put32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+
+    file.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+}
+
+// The pixels go in stored deflate blocks: no compression library, and the
+// files are small next to the renders they come from.
+bool write_png(const char *path, const unsigned char *rgb, int width, int height)
+{
+    std::ofstream file(path, std::ios::binary);
+
+    if( !file )
+        return false;
+
+    const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    file.write(reinterpret_cast<const char *>(signature), 8);
+
+    std::vector<unsigned char> header;
+    put32(header, width);
+    put32(header, height);
+    header.push_back(8);    // Bit depth.
+    header.push_back(2);    // RGB.
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    write_chunk(file, "IHDR", header);
+
+    // Scanlines top first, each after a zero filter byte.
+    std::vector<unsigned char> raw;
+    raw.reserve(size_t(height) * (3 * width + 1));
+    for(int j = height - 1; j >= 0; --j) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb + size_t(j) * 3 * width, rgb + size_t(j + 1) * 3 * width);
+    }
+
+    std::vector<unsigned char> z;
+    z.push_back(0x78);
+    z.push_back(0x01);
+
+    for(size_t pos = 0; pos < raw.size() || pos == 0; ) {
+        size_t n = raw.size() - pos < 65535 ? raw.size() - pos : 65535;
+        bool last = pos + n == raw.size();
+
+        z.push_back(last ? 1 : 0);
+        z.push_back(n & 255);
+        z.push_back(n >> 8);
+        z.push_back(~n & 255);
+        z.push_back((~n >> 8) & 255);
+        z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+
+        pos += n;
+        if( last )
+            break;
+    }
+
+    uint32_t a = 1, b = 0;
+    for(unsigned char c : raw) {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    put32(z, (b << 16) | a);
+
+    write_chunk(file, "IDAT", z);
+    write_chunk(file, "IEND", std::vector<unsigned char>());
+
+    return bool(file);
+}
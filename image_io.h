@@ -0,0 +1,17 @@
+#ifndef __IMAGE_IO_H__
+#define __IMAGE_IO_H__
+
+#include <vector>
+
+// Writers for the extra images, the beauty image is still written by main.
+// Rows go bottom first, as the renderer stores them. False when the file
+// could not be written.
+
+// Portable float map, one channel or three interleaved ones.
+bool write_pfm(const char *path, const float *values, int width, int height, int channels = 1);
+bool read_pfm(const char *path, std::vector<float> &values, int &width, int &height, int &channels);
+
+// 8 bit RGB PNG, not compressed.
+bool write_png(const char *path, const unsigned char *rgb, int width, int height);
+
+#endif // __IMAGE_IO_H__
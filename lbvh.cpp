@@ -0,0 +1,325 @@
+#include "bvh_node.h"
+#include "bvh_build.h"
+#include "parallel.h"
+#include "morton.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+#include <thread>
+
+const int kMorton63Threshold = 1 << 18;    // Beyond this, 10 bits per axis put too many primitives in one cell.
+const int kTreeletLeaves = 7;
+const int kTreeletMinPrims = 32;            // Smaller subtrees are not worth restructuring.
+
+//
+// KARRAS HIERARCHY
+//
+
+// Length of the common prefix of codes i and j, ties broken by index.
+static inline int delta(const uint64_t *codes, int n, int i, int j)
+{
+    if( j < 0 || j >= n )
+        return -1;
+
+    uint64_t x = codes[i] ^ codes[j];
+
+    if( x == 0 )
+        return 64 + __builtin_clz(uint32_t(i ^ j));
+
+    return __builtin_clzll(x);
+}
+
+// Finds the range and split of internal node i, independently of every other node.
+static void karras_node(const uint64_t *codes, int n, int i, lbvh_internal &node)
+{
+    int d = (delta(codes, n, i, i + 1) - delta(codes, n, i, i - 1)) >= 0 ? 1 : -1;
+    int dmin = delta(codes, n, i, i - d);
+
+    int lmax = 2;
+    while( delta(codes, n, i, i + lmax * d) > dmin )
+        lmax *= 2;
+
+    int l = 0;
+    for(int t = lmax / 2; t >= 1; t /= 2) {
+        if( delta(codes, n, i, i + (l + t) * d) > dmin )
+            l += t;
+    }
+
+    int j = i + l * d;
+    int dnode = delta(codes, n, i, j);
+
+    int s = 0;
+    int t = l;
+    do {
+        t = (t + 1) >> 1;
+        if( delta(codes, n, i, i + (s + t) * d) > dnode )
+            s += t;
+    }
+    while( t > 1 );
+
+    int gamma = i + s * d + std::min(d, 0);
+
+    node.first = std::min(i, j);
+    node.last = std::max(i, j);
+    node.child[0] = node.first == gamma ? ~gamma : gamma;
+    node.child[1] = node.last == gamma + 1 ? ~(gamma + 1) : gamma + 1;
+}
+
+// Split axis is where the children centers differ most, first child the lower one.
+static void set_axis(bvh_build_node *node)
+{
+    vec3 c0 = node->child[0]->box.min() + node->child[0]->box.max();
+    vec3 c1 = node->child[1]->box.min() + node->child[1]->box.max();
+    vec3 d = c1 - c0;
+
+    node->axis = 0;
+    for(int a = 1; a < 3; ++a) {
+        if( std::fabs(d[a]) > std::fabs(d[node->axis]) )
+            node->axis = a;
+    }
+
+    if( d[node->axis] < 0.0 )
+        std::swap(node->child[0], node->child[1]);
+}
+
+bvh_build_node *bvh_builder::emit_lbvh(const lbvh_internal *internal, int child, int depth)
+{
+    bvh_build_node *node = new bvh_build_node;
+    ++node_count;
+
+    if( child < 0 ) {
+        leaf(node, ~child, ~child + 1);
+        node->box = refs[~child].box;
+        node->prims = 1;
+        node->cost = node->box.surface_area();
+
+        return node;
+    }
+
+    const lbvh_internal &in = internal[child];
+
+    // Clustered codes can make the Karras tree deeper than the stack, what is left is one leaf.
+    if( depth >= kBVHMaxDepth - 1 ) {
+        assert(in.last + 1 - in.first <= kBVHMaxLeafPrims);
+        leaf(node, in.first, in.last + 1);
+        node->box = empty_box();
+        for(int i = in.first; i <= in.last; ++i)
+            grow(node->box, refs[i].box);
+        node->prims = node->count;
+        node->cost = node->box.surface_area() * node->prims;
+
+        return node;
+    }
+
+    node->child[0] = emit_lbvh(internal, in.child[0], depth + 1);
+    node->child[1] = emit_lbvh(internal, in.child[1], depth + 1);
+    node->first = node->count = 0;
+    node->box = surrounding(node->child[0]->box, node->child[1]->box);
+    node->prims = node->child[0]->prims + node->child[1]->prims;
+    set_axis(node);
+
+    float area = node->box.surface_area();
+    float split_cost = kTraversalCost * area + node->child[0]->cost + node->child[1]->cost;
+
+    // Karras leaves hold one primitive, merge the small subtrees that SAH prefers as a leaf.
+    if( node->prims <= kMaxLeafSize && area * node->prims <= split_cost ) {
+        delete node->child[0];
+        delete node->child[1];
+        node_count -= 2;
+
+        leaf(node, in.first, in.last + 1);
+        node->cost = area * node->prims;
+    }
+    else {
+        node->cost = split_cost;
+    }
+
+    return node;
+}
+
+//
+// TREELET RESTRUCTURING
+//
+
+// Karras & Aila: grow a treelet of up to seven leaves under the node, find
+// the topology of least SAH cost over them and rewire its interior nodes.
+static void restructure_treelet(bvh_build_node *root)
+{
+    bvh_build_node *leaves[kTreeletLeaves];
+    bvh_build_node *interior[kTreeletLeaves - 1];
+    int nleaves = 2,
+        ninterior = 1;
+
+    // The subtrees below were restructured first, the cost set when the root was emitted is stale.
+    root->cost = kTraversalCost * root->box.surface_area() + root->child[0]->cost + root->child[1]->cost;
+
+    leaves[0] = root->child[0];
+    leaves[1] = root->child[1];
+    interior[0] = root;
+
+    while( nleaves < kTreeletLeaves ) {
+        int best = -1;
+        float best_area = -1.0;
+
+        for(int i = 0; i < nleaves; ++i) {
+            float area = leaves[i]->box.surface_area();
+            if( leaves[i]->count == 0 && area > best_area ) {
+                best = i;
+                best_area = area;
+            }
+        }
+
+        if( best < 0 )
+            break;
+
+        bvh_build_node *expanded = leaves[best];
+        interior[ninterior++] = expanded;
+        leaves[best] = expanded->child[0];
+        leaves[nleaves++] = expanded->child[1];
+    }
+
+    if( nleaves < 3 )
+        return;
+
+    const int subsets = 1 << nleaves;
+    aabb box[1 << kTreeletLeaves];
+    float cost[1 << kTreeletLeaves];
+    int split[1 << kTreeletLeaves];
+
+    for(int s = 1; s < subsets; ++s) {
+        int low = s & -s;
+        int i = __builtin_ctz(low);
+
+        if( s == low ) {
+            box[s] = leaves[i]->box;
+            cost[s] = leaves[i]->cost;
+            continue;
+        }
+
+        box[s] = surrounding(box[s ^ low], leaves[i]->box);
+        cost[s] = FLT_MAX;
+
+        // Every partition once, keeping the lowest leaf on the first side.
+        for(int p = (s - 1) & s; p > 0; p = (p - 1) & s) {
+            if( !(p & low) )
+                continue;
+
+            float c = cost[p] + cost[s ^ p];
+            if( c < cost[s] ) {
+                cost[s] = c;
+                split[s] = p;
+            }
+        }
+
+        cost[s] += kTraversalCost * box[s].surface_area();
+    }
+
+    if( cost[subsets - 1] >= root->cost * 0.999f )
+        return;
+
+    // Rebuild top down, reusing the interior nodes of the old treelet.
+    struct rebuild
+    {
+        static bvh_build_node *node(int s, bvh_build_node **leaves, bvh_build_node **interior, int &next,
+                                    const aabb *box, const float *cost, const int *split)
+        {
+            if( (s & (s - 1)) == 0 )
+                return leaves[__builtin_ctz(s)];
+
+            bvh_build_node *n = interior[next++];
+            n->child[0] = node(split[s], leaves, interior, next, box, cost, split);
+            n->child[1] = node(s ^ split[s], leaves, interior, next, box, cost, split);
+            n->box = box[s];
+            n->cost = cost[s];
+            n->prims = n->child[0]->prims + n->child[1]->prims;
+            set_axis(n);
+
+            return n;
+        }
+    };
+
+    int next = 0;
+    rebuild::node(subsets - 1, leaves, interior, next, box, cost, split);
+}
+
+void bvh_builder::optimize_treelets(bvh_build_node *node)
+{
+    if( node->count > 0 || node->prims < kTreeletMinPrims )
+        return;
+
+    // Children first, a treelet only depends on the subtrees below its leaves.
+    if( node->prims >= kSpawnThreshold && active_threads.fetch_add(1) < max_threads ) {
+        std::thread left([=]() { perf_phase_scope scope(perf_phase_bvh); optimize_treelets(node->child[0]); });
+        optimize_treelets(node->child[1]);
+        left.join();
+        --active_threads;
+    }
+    else {
+        if( node->prims >= kSpawnThreshold )
+            --active_threads;
+
+        optimize_treelets(node->child[0]);
+        optimize_treelets(node->child[1]);
+    }
+
+    restructure_treelet(node);
+}
+
+//
+// LINEAR BUILDER
+//
+
+bvh_build_node *bvh_builder::build_lbvh(bool treelets)
+{
+    int n = int(refs.size());
+    aabb box, cbox;
+    bounds(0, n, box, cbox);
+
+    if( n == 1 ) {
+        bvh_build_node *node = leaf(new bvh_build_node, 0, 1);
+        ++node_count;
+        node->box = box;
+
+        return node;
+    }
+
+    int bits = n > kMorton63Threshold ? 63 : 30;
+    vec3 extent = cbox.max() - cbox.min();
+    std::vector<uint64_t> codes(n);
+    std::vector<int> order(n);
+
+    parallel_for(0, n, 4096, [&](int begin, int end) {
+        for(int i = begin; i < end; ++i) {
+            vec3 p = refs[i].centroid - cbox.min();
+            for(int a = 0; a < 3; ++a)
+                p[a] = extent[a] > 0.0 ? p[a] / extent[a] : 0.5;
+
+            codes[i] = morton_code(p, bits);
+            order[i] = i;
+        }
+    });
+
+    radix_sort(codes, order, bits, n >= kParallelBinThreshold ? max_threads : 1);
+
+    std::vector<bvh_prim_ref> sorted(n);
+    std::vector<lbvh_internal> internal(n - 1);
+
+    parallel_for(0, n, 4096, [&](int begin, int end) {
+        for(int i = begin; i < end; ++i)
+            sorted[i] = refs[order[i]];
+    });
+    refs.swap(sorted);
+
+    parallel_for(0, n - 1, 4096, [&](int begin, int end) {
+        for(int i = begin; i < end; ++i)
+            karras_node(codes.data(), n, i, internal[i]);
+    });
+
+    bvh_build_node *root = emit_lbvh(internal.data(), 0, 0);
+
+    if( treelets )
+        optimize_treelets(root);
+
+    return root;
+}
@@ -0,0 +1,293 @@
+#include "light_tree.h"
+#include "memory_stats.h"
+#include "rangen.h"
+
+#include <algorithm>
+
+const int kLightTreeBins = 12;
+const int kLightTreeMaxDepth = 64;     // Also the traversal stack size, deeper subtrees are split in halves.
+
+light_tree::light_tree(hitable **l, int n, float time0, float time1, light_sampler_kind k) : lights(l, l + n), kind(k)
+{
+    std::vector<aabb> boxes(n);
+    std::vector<float> powers(n);
+    std::vector<int> order(n);
+
+    for(int i = 0; i < n; ++i) {
+        lights[i]->bounding_box(time0, time1, boxes[i]);
+        powers[i] = lights[i]->power();
+        order[i] = i;
+    }
+
+    nodes.reserve(2 * n - 1);
+    build(order, 0, n, boxes, powers, 0);
+
+    if( kind == light_sampler_power )
+        by_power = alias_table(powers.data(), n);
+
+    account_memory(memory_bvh, (long long)nodes.capacity() * sizeof(light_tree_node) + (long long)n * sizeof(hitable *) + by_power.bytes(), 0);
+}
+
+// Binned like the SAH builder, the cost of a child being its power times its surface area.
+int light_tree::build(std::vector<int> &order, int begin, int end, const std::vector<aabb> &boxes,
+                      const std::vector<float> &powers, int depth)
+{
+    int index = int(nodes.size());
+    nodes.push_back(light_tree_node());
+
+    aabb box = empty_box(), centroids = empty_box();
+    float power = 0.0;
+
+    for(int i = begin; i < end; ++i) {
+        box = surrounding(box, boxes[order[i]]);
+        centroids = surrounding(centroids, 0.5 * (boxes[order[i]].min() + boxes[order[i]].max()));
+        power += powers[order[i]];
+    }
+
+    nodes[index].box = box;
+    nodes[index].power = power;
+    nodes[index].count = end - begin;
+
+    if( end - begin == 1 ) {
+        nodes[index].offset = order[begin];
+        return index;
+    }
+
+    int mid = begin + (end - begin) / 2;
+    float best_cost = FLT_MAX;
+    int best_axis = -1, best_split = 0;
+
+    for(int axis = 0; axis < 3 && depth < kLightTreeMaxDepth / 2; ++axis) {
+        float lo = centroids.min()[axis],
+              extent = centroids.max()[axis] - lo;
+
+        if( extent <= 0.0 )
+            continue;
+
+        aabb bin_boxes[kLightTreeBins];
+        float bin_powers[kLightTreeBins] = {};
+        int bin_counts[kLightTreeBins] = {};
+
+        for(int b = 0; b < kLightTreeBins; ++b)
+            bin_boxes[b] = empty_box();
+
+        for(int i = begin; i < end; ++i) {
+            float c = 0.5 * (boxes[order[i]].min()[axis] + boxes[order[i]].max()[axis]);
+            int b = std::min(kLightTreeBins - 1, int(kLightTreeBins * (c - lo) / extent));
+            bin_boxes[b] = surrounding(bin_boxes[b], boxes[order[i]]);
+            bin_powers[b] += powers[order[i]];
+            ++bin_counts[b];
+        }
+
+        for(int split = 1; split < kLightTreeBins; ++split) {
+            aabb left = empty_box(), right = empty_box();
+            float left_power = 0.0, right_power = 0.0;
+            int left_count = 0;
+
+            for(int b = 0; b < split; ++b) {
+                left = surrounding(left, bin_boxes[b]);
+                left_power += bin_powers[b];
+                left_count += bin_counts[b];
+            }
+            for(int b = split; b < kLightTreeBins; ++b) {
+                right = surrounding(right, bin_boxes[b]);
+                right_power += bin_powers[b];
+            }
+
+            if( left_count == 0 || left_count == end - begin )
+                continue;
+
+            // Lights without power still count, they have to go somewhere.
+            float cost = (left_power + 1e-6f) * left.surface_area() + (right_power + 1e-6f) * right.surface_area();
+            if( cost < best_cost ) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    if( best_axis >= 0 ) {
+        float lo = centroids.min()[best_axis],
+              extent = centroids.max()[best_axis] - lo;
+
+        mid = int(std::partition(order.begin() + begin, order.begin() + end, [&](int l) {
+            float c = 0.5 * (boxes[l].min()[best_axis] + boxes[l].max()[best_axis]);
+            return std::min(kLightTreeBins - 1, int(kLightTreeBins * (c - lo) / extent)) < best_split;
+        }) - order.begin());
+    }
+
+    build(order, begin, mid, boxes, powers, depth + 1);
+    nodes[index].offset = build(order, mid, end, boxes, powers, depth + 1);
+
+    return index;
+}
+
+// From the closest point of the node's box, so a cluster right above p is
+// not taken for a far one. Inside the box the distance is a tenth of its
+// diagonal, not zero.
+static float importance(const light_tree_node &node, const vec3 &p, light_sampler_kind kind)
+{
+    if( kind == light_sampler_uniform )
+        return float(node.count);
+    if( kind == light_sampler_power )
+        return node.power;
+
+    vec3 lo = node.box.min(), hi = node.box.max();
+    vec3 closest(std::max(lo[0], std::min(p[0], hi[0])),
+                 std::max(lo[1], std::min(p[1], hi[1])),
+                 std::max(lo[2], std::min(p[2], hi[2])));
+    float distance_squared = std::max((closest - p).squared_length(), 0.01f * (hi - lo).squared_length());
+
+    return node.power / distance_squared;
+}
+
+float light_tree::first_child_probability(int i, const vec3 &p) const
+{
+    float first = importance(nodes[i + 1], p, kind),
+          second = importance(nodes[nodes[i].offset], p, kind);
+
+    return first + second > 0.0 ? first / (first + second) : 0.5;
+}
+
+vec3 light_tree::random(const vec3 &o) const
+{
+    float u = drand48();
+    int i = 0;
+
+    if( kind == light_sampler_power )
+        return lights[by_power.sample(u)]->random(o);
+
+    // One random number for the whole descent, rescaled at every level.
+    while( nodes[i].count > 1 ) {
+        float p = first_child_probability(i, o);
+
+        if( u < p ) {
+            u = u / p;
+            i = i + 1;
+        }
+        else {
+            u = (u - p) / (1.0f - p);
+            i = nodes[i].offset;
+        }
+        u = std::min(u, 0.99999994f);
+    }
+
+    return lights[nodes[i].offset]->random(o);
+}
+
+// Only the lights v points at contribute, the nodes it misses are skipped.
+float light_tree::pdf_value(const vec3 &o, const vec3 &v) const
+{
+    int stack[kLightTreeMaxDepth + 2];
+    float probability[kLightTreeMaxDepth + 2];
+    int top = 0;
+    float pdf = 0.0;
+    ray r(o, v);
+
+    stack[top] = 0;
+    probability[top++] = 1.0;
+
+    while( top > 0 ) {
+        --top;
+        int i = stack[top];
+        float p = probability[top];
+
+        if( p <= 0.0 || !nodes[i].box.hit(r, 0.001, FLT_MAX) )
+            continue;
+
+        if( nodes[i].count == 1 ) {
+            if( kind == light_sampler_power )
+                p = by_power.pmf(nodes[i].offset);
+            pdf += p * lights[nodes[i].offset]->pdf_value(o, v);
+            continue;
+        }
+
+        float first = first_child_probability(i, o);
+        stack[top] = i + 1;
+        probability[top++] = p * first;
+        stack[top] = nodes[i].offset;
+        probability[top++] = p * (1.0f - first);
+    }
+
+    return pdf;
+}
+
+bool light_tree::hit(const ray &r, float tmin, float tmax, hit_record &rec) const
+{
+    int stack[kLightTreeMaxDepth + 2];
+    int top = 0;
+    bool hit_anything = false;
+
+    stack[top++] = 0;
+
+    while( top > 0 ) {
+        int i = stack[--top];
+
+        if( !nodes[i].box.hit(r, tmin, tmax) )
+            continue;
+
+        if( nodes[i].count == 1 ) {
+            if( lights[nodes[i].offset]->hit(r, tmin, tmax, rec) ) {
+                hit_anything = true;
+                tmax = rec.t;
+            }
+            continue;
+        }
+
+        stack[top++] = nodes[i].offset;
+        stack[top++] = i + 1;
+    }
+
+    return hit_anything;
+}
+
+bool light_tree::occluded(const ray &r, float tmin, float tmax) const
+{
+    int stack[kLightTreeMaxDepth + 2];
+    int top = 0;
+
+    stack[top++] = 0;
+
+    while( top > 0 ) {
+        int i = stack[--top];
+
+        if( !nodes[i].box.hit(r, tmin, tmax) )
+            continue;
+
+        if( nodes[i].count == 1 ) {
+            if( lights[nodes[i].offset]->occluded(r, tmin, tmax) )
+                return true;
+            continue;
+        }
+
+        stack[top++] = nodes[i].offset;
+        stack[top++] = i + 1;
+    }
+
+    return false;
+}
+
+hitable *make_light_sampler(hitable *lights, float time0, float time1, light_sampler_kind kind)
+{
+    if( !lights )
+        return nullptr;
+
+    std::vector<hitable *> list;
+    aabb box;
+
+    if( hitable_list *l = dynamic_cast<hitable_list *>(lights) )
+        list.assign(l->list, l->list + l->list_size);
+    else
+        list.push_back(lights);
+
+    if( list.size() < 2 )
+        return lights;
+
+    // Unbounded ones can not be sampled anyway.
+    list.erase(std::remove_if(list.begin(), list.end(), [&](hitable *h) { return !h->bounding_box(time0, time1, box); }), list.end());
+    if( list.empty() )
+        return nullptr;
+
+    return new light_tree(list.data(), int(list.size()), time0, time1, kind);
+}
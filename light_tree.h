@@ -0,0 +1,69 @@
+#ifndef __LIGHT_TREE_H__
+#define __LIGHT_TREE_H__
+
+#include <vector>
+
+#include "hitables.h"
+#include "aabb.h"
+#include "alias_table.h"
+
+// How the light sampling integrator picks the light to sample.
+enum light_sampler_kind
+{
+    light_sampler_uniform,  // Every light as likely, the noise grows with their number.
+    light_sampler_power,    // Proportional to its emitted power, wherever the shading point is.
+    light_sampler_tree      // By its estimated contribution to the shading point, down a light BVH.
+};
+
+struct light_tree_node
+{
+    aabb    box;
+    float   power;      // Of the lights under the node.
+    int     count,
+            offset;     // Interior: index of the second child, the first is the next node. Leaf: the light.
+};
+
+// Lights in a BVH clustered by position and power, one per leaf. Picking one
+// goes down from the root choosing each child with probability proportional
+// to its importance at the shading point, power over squared distance, so
+// random() and pdf_value() only visit the nodes on the way to the lights
+// involved. With uniform picking the importance is the light count. Picking
+// by power alone goes straight to the light through an alias table, the tree
+// still bounds the lights pdf_value() has to ask.
+class light_tree : public hitable
+{
+    public:
+        RT_MEMORY_CATEGORY(memory_bvh)
+
+        // The n lights in l must be bounded.
+        light_tree(hitable **l, int n, float time0, float time1, light_sampler_kind k);
+
+        virtual bool hit(const ray &r, float tmin, float tmax, hit_record &rec) const;
+        virtual bool occluded(const ray &r, float tmin, float tmax) const;
+        virtual bool bounding_box(float t0, float t1, aabb &b) const
+        {
+            b = nodes[0].box;
+            return true;
+        }
+        virtual float pdf_value(const vec3 &o, const vec3 &v) const;
+        virtual vec3 random(const vec3 &o) const;
+
+        // Probability of going down to the first child of interior node i from p.
+        float first_child_probability(int i, const vec3 &p) const;
+
+        std::vector<hitable *>          lights;
+        std::vector<light_tree_node>    nodes;
+        light_sampler_kind              kind;
+        alias_table                     by_power;   // Over lights, for light_sampler_power.
+
+    private:
+        int build(std::vector<int> &order, int begin, int end, const std::vector<aabb> &boxes,
+                  const std::vector<float> &powers, int depth);
+};
+
+// The sampler over the emitters in lights, a hitable_list of them or a
+// single one, as the scenes set them. The lights themselves when there is
+// only one, nullptr for none.
+hitable *make_light_sampler(hitable *lights, float time0, float time1, light_sampler_kind kind);
+
+#endif // __LIGHT_TREE_H__
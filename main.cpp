@@ -1,6 +1,8 @@
 #include <iostream>
 #include <fstream>
-#include <float.h>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
 
 #include "rangen.h"
 
@@ -12,6 +14,19 @@
 #include "instances.h"
 #include "constant_medium.h"
 #include "bvh_node.h"
+#include "compile.h"
+#include "stats.h"
+#include "scene.h"
+#include "render.h"
+#include "perf_counters.h"
+#include "heatmap.h"
+#include "bench.h"
+#include "scene_bench.h"
+#include "converge.h"
+#include "parallel.h"
+#include "timeline.h"
+#include "memory_stats.h"
+#include "light_tree.h"
 
 #include "materials.h"
 #include "textures.h"
@@ -19,40 +34,46 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-struct scene
+// An image file as a texture, grey when it can not be read.
+texture *image_file_texture(const char *file)
 {
-    hitable *world;
-    camera  *cam;
-    int nx, ny, ns;
-};
+    timeline_scope span("stbi_load", "scene");
+    span.arg("file", file);
+    
+    int nx, ny, nn;
+    unsigned char *tex_data = stbi_load(file, &nx, &ny, &nn, 0);
+    
+    if( !tex_data ) {
+        std::cerr << "Could not load " << file << "\n";
+        return new constant_texture(vec3(0.5, 0.5, 0.5));
+    }
+    
+    return new image_texture(tex_data, nx, ny);
+}
 
-vec3 color(const ray &r, hitable *world, int depth)
+// A latitude-longitude image file as the environment, HDR or not, linear. A
+// dim grey one when it can not be read.
+environment_map *environment_file(const char *file)
 {
-    hit_record rec;
-    if(world->hit(r, 0.001, FLT_MAX, rec)) {
-        ray scattered;
-        vec3 attenuation;
-        vec3 emmited = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
-        
-        if ( depth < 50 && rec.mat_ptr->scatter(r, rec, attenuation, scattered) ) {
-            return emmited + attenuation * color(scattered, world, depth+1);
-            
-        }
-        else {
-            return emmited;
-        }
-    }
-    else {
-        /*
-        vec3 unit_direction = unit_vector(r.direction());
-        float t = 0.5 * (unit_direction.y() + 1.0);
-        return (1.0 - t) * vec3(1.0, 1.0, 1.0) + t * vec3(0.5, 0.7, 1.0);
-        */
-        return vec3(0.0, 0.0, 0.0);          
+    timeline_scope span("stbi_loadf", "scene");
+    span.arg("file", file);
+    
+    int nx, ny, nn;
+    float *rgb = stbi_loadf(file, &nx, &ny, &nn, 3);
+    
+    if( !rgb ) {
+        std::cerr << "Could not load " << file << "\n";
+        const float grey[3] = {0.5, 0.5, 0.5};
+        return new environment_map(grey, 1, 1);
     }
+    
+    environment_map *environment = new environment_map(rgb, nx, ny);
+    stbi_image_free(rgb);
+    
+    return environment;
 }
 
-hitable *random_scene()
+void random_scene(scene &the_scene)
 {
     int n = 500;
     hitable **list = new hitable*[n+1];
@@ -91,10 +112,33 @@ hitable *random_scene()
     list[i++] = new sphere(vec3(-4.0, 1.0, 0.0), 1.0, new lambertian(new constant_texture(vec3(0.4, 0.2, 0.1))));
     list[i++] = new sphere(vec3(4.0, 1.0, 0.0), 1.0, new metal(vec3(0.7, 0.6, 0.5), 0.0));
     
-    return new hitable_list(list, i);
+    the_scene.cam = new camera(
+        vec3(13.0, 2.0, 3.0),       // lookfrom
+        vec3(0.0, 0.0, 0.0),        // lookat
+        vec3(0.0, 1.0, 0.0),        // camup
+        20.0,                       // vfov
+        float(the_scene.nx)/the_scene.ny,  // aspect
+        0.1,                        // aperture
+        10.0,                       // dist_to_focus
+        0.0,                        // t0
+        1.0);                       // t1
+    
+    the_scene.world = new hitable_list(list, i);
+}
+
+// Lit by sky.hdr in the working directory instead of by emitters, by the
+// built in daylight sky when there is no such file.
+void random_scene_sky(scene &the_scene)
+{
+    random_scene(the_scene);
+
+    if( std::ifstream("sky.hdr").good() )
+        the_scene.environment = environment_file("sky.hdr");
+    else
+        the_scene.environment = daylight_sky();
 }
 
-hitable *standard_scene()
+void standard_scene(scene &the_scene)
 {
     hitable **list = new hitable*[5];
     
@@ -104,10 +148,21 @@ hitable *standard_scene()
     list[3] = new sphere(vec3(-1.0, 0.0, -1.0), 0.5, new dielectric(1.5));
     list[4] = new sphere(vec3(-1.0, 0.0, -1.0), -0.45, new dielectric(1.5));
    
-    return new hitable_list(list, 5);
+    the_scene.cam = new camera(
+        vec3(3.0, 3.0, 2.0),        // lookfrom
+        vec3(0.0, 0.0, -1.0),       // lookat
+        vec3(0.0, 1.0, 0.0),        // camup
+        20.0,                       // vfov
+        float(the_scene.nx)/the_scene.ny,  // aspect
+        2.0,                        // aperture
+        sqrt(17.0),                 // dist_to_focus
+        0.0,                        // t0
+        1.0);                       // t1
+    
+    the_scene.world = new hitable_list(list, 5);
 }
 
-hitable *two_spheres()
+void two_spheres(scene &the_scene)
 {
     texture *checker = new checker_texture(
         new constant_texture(vec3(0.2, 0.3, 0.1)),
@@ -119,41 +174,89 @@ hitable *two_spheres()
     list[0] = new sphere(vec3(0, -10, 0), 10, new lambertian(checker));
     list[1] = new sphere(vec3(0, 10, 0), 10, new lambertian(checker));
     
-    return new hitable_list(list, 2);
+    the_scene.cam = new camera(
+        vec3(13.0, 2.0, 3.0),       // lookfrom
+        vec3(0.0, 0.0, 0.0),        // lookat
+        vec3(0.0, 1.0, 0.0),        // camup
+        20.0,                       // vfov
+        float(the_scene.nx)/the_scene.ny,  // aspect
+        0.0,                        // aperture
+        10.0,                       // dist_to_focus
+        0.0,                        // t0
+        1.0);                       // t1
+    
+    the_scene.world = new hitable_list(list, 2);
 }
 
-hitable *two_perlin_spheres()
+void two_perlin_spheres(scene &the_scene)
 {
     texture *per_text = new noise_texture(4.0);
     
     hitable **list = new hitable*[2];
     
-    list[0] = new sphere(vec3(0, -1000, 0), 1000, new lambertian(per_text));
+    list[0] = new plane(vec3(0, 0, 0), vec3(0, 1, 0), new lambertian(per_text));
     list[1] = new sphere(vec3(0, 2, 0), 2, new lambertian(per_text));
     
-    return new hitable_list(list, 2);
+    the_scene.cam = new camera(
+        vec3(13.0, 2.0, 3.0),       // lookfrom
+        vec3(0.0, 2.0, 0.0),        // lookat
+        vec3(0.0, 1.0, 0.0),        // camup
+        20.0,                       // vfov
+        float(the_scene.nx)/the_scene.ny,  // aspect
+        0.0,                        // aperture
+        10.0,                       // dist_to_focus
+        0.0,                        // t0
+        1.0);                       // t1
+    
+    the_scene.world = new hitable_list(list, 2);
 }
 
-hitable *earth_sphere()
+void earth_sphere(scene &the_scene)
 {    
-    int nx, ny, nn;
-    //unsigned char *tex_data = stbi_load("checker.png", &nx, &ny, &nn, 0);
-    unsigned char *tex_data = stbi_load("earthmap.jpg", &nx, &ny, &nn, 0);
-    material *mat =  new lambertian(new image_texture(tex_data, nx, ny));
-    return new sphere(vec3(0.0, 0.0, 0.0), 2.0, mat);
+    //material *mat =  new lambertian(image_file_texture("checker.png"));
+    material *mat =  new lambertian(image_file_texture("earthmap.jpg"));
+    
+    the_scene.cam = new camera(
+        vec3(13.0, 2.0, 3.0),       // lookfrom
+        vec3(0.0, 0.0, 0.0),        // lookat
+        vec3(0.0, 1.0, 0.0),        // camup
+        20.0,                       // vfov
+        float(the_scene.nx)/the_scene.ny,  // aspect
+        0.0,                        // aperture
+        10.0,                       // dist_to_focus
+        0.0,                        // t0
+        1.0);                       // t1
+    
+    the_scene.world = new sphere(vec3(0.0, 0.0, 0.0), 2.0, mat);
 }
 
-hitable *simple_light()
+void simple_light(scene &the_scene)
 {
     texture *per_text = new noise_texture(4.0);
     hitable **list = new hitable*[4];
     
-    list[0] = new sphere(vec3(0, -1000, 0), 1000, new lambertian(per_text));
+    list[0] = new plane(vec3(0, 0, 0), vec3(0, 1, 0), new lambertian(per_text));
     list[1] = new sphere(vec3(0, 2, 0), 2, new lambertian(per_text));
     list[2] = new sphere(vec3(0, 7, 0), 2, new diffuse_light(new constant_texture(vec3(4.0, 4.0, 4.0))));
     list[3] = new rect_xy(3.0, 5.0, 1.0, 3.0, -2.0, new diffuse_light(new constant_texture(vec3(4.0, 4.0, 4.0))));
     
-    return new hitable_list(list, 4);
+    hitable **lights = new hitable*[2];
+    lights[0] = list[2];
+    lights[1] = list[3];
+    
+    the_scene.cam = new camera(
+        vec3(26.0, 3.0, 6.0),       // lookfrom
+        vec3(0.0, 2.0, 0.0),        // lookat
+        vec3(0.0, 1.0, 0.0),        // camup
+        20.0,                       // vfov
+        float(the_scene.nx)/the_scene.ny,  // aspect
+        0.0,                        // aperture
+        10.0,                       // dist_to_focus
+        0.0,                        // t0
+        1.0);                       // t1
+    
+    the_scene.world = new hitable_list(list, 4);
+    the_scene.lights = new hitable_list(lights, 2);
 }
 
 void cornell_box(scene &the_scene)
@@ -168,7 +271,7 @@ void cornell_box(scene &the_scene)
     
     list[i++] = new flip_normals(new rect_yz(0, 555, 0, 555, 555, green));
     list[i++] = new rect_yz(0, 555, 0, 555, 0, red);
-    list[i++] = new rect_xz(213, 343, 227, 332, 554, light);
+    list[i++] = the_scene.lights = new rect_xz(213, 343, 227, 332, 554, light);
     //list[i++] = new rect_xz(113, 443, 127, 432, 554, light2);
     list[i++] = new flip_normals(new rect_xz(0, 555, 0, 555, 555, white));
     list[i++] = new rect_xz(0, 555, 0, 555, 0, white);
@@ -183,7 +286,7 @@ void cornell_box(scene &the_scene)
         vec3(278.0, 278.0, 0.0),    // lookat
         vec3(0.0, 1.0, 0.0),        // camup
         40.0,                       // vfov
-        the_scene.nx/the_scene.ny,  // aspect
+        float(the_scene.nx)/the_scene.ny,  // aspect
         0.0,                        // aperture
         10.0,                       // dist_to_focus
         0.0,                        // t0
@@ -203,7 +306,7 @@ void cornell_smoke(scene &the_scene)
     
     list[i++] = new flip_normals(new rect_yz(0, 555, 0, 555, 555, green));
     list[i++] = new rect_yz(0, 555, 0, 555, 0, red);
-    list[i++] = new rect_xz(113, 443, 127, 432, 554, light);
+    list[i++] = the_scene.lights = new rect_xz(113, 443, 127, 432, 554, light);
     list[i++] = new flip_normals(new rect_xz(0, 555, 0, 555, 555, white));
     list[i++] = new rect_xz(0, 555, 0, 555, 0, white);
     list[i++] = new flip_normals(new rect_xy(0, 555, 0, 555, 555, white));
@@ -217,7 +320,7 @@ void cornell_smoke(scene &the_scene)
         vec3(278.0, 278.0, 0.0),    // lookat
         vec3(0.0, 1.0, 0.0),        // camup
         40.0,                       // vfov
-        the_scene.nx/the_scene.ny,  // aspect
+        float(the_scene.nx)/the_scene.ny,  // aspect
         0.0,                        // aperture
         10.0,                       // dist_to_focus
         0.0,                        // t0
@@ -239,7 +342,7 @@ void cornell_balls(scene &the_scene)
     
     list[i++] = new flip_normals(new rect_yz(0, 555, 0, 555, 555, green));
     list[i++] = new rect_yz(0, 555, 0, 555, 0, red);
-    list[i++] = new rect_xz(113, 443, 127, 432, 554, light);
+    list[i++] = the_scene.lights = new rect_xz(113, 443, 127, 432, 554, light);
     list[i++] = new flip_normals(new rect_xz(0, 555, 0, 555, 555, white));
     list[i++] = new rect_xz(0, 555, 0, 555, 0, white);
     list[i++] = new flip_normals(new rect_xy(0, 555, 0, 555, 555, white));
@@ -253,7 +356,7 @@ void cornell_balls(scene &the_scene)
         vec3(278.0, 278.0, 0.0),    // lookat
         vec3(0.0, 1.0, 0.0),        // camup
         40.0,                       // vfov
-        the_scene.nx/the_scene.ny,  // aspect
+        float(the_scene.nx)/the_scene.ny,  // aspect
         0.0,                        // aperture
         10.0,                       // dist_to_focus
         0.0,                        // t0
@@ -281,9 +384,7 @@ void final_test(scene &the_scene)
     material *aluminum = new metal(vec3(0.8, 0.8, 0.9), 10.0);
     material *bw_marble = new lambertian(pertext);
     
-    int nx, ny, nn;
-    unsigned char *tex_data = stbi_load("earthmap.jpg", &nx, &ny, &nn, 0);
-    material *emat =  new lambertian(new image_texture(tex_data, nx, ny));
+    material *emat =  new lambertian(image_file_texture("earthmap.jpg"));
     
     int     nb = 20,
             b = 0;
@@ -303,8 +404,8 @@ void final_test(scene &the_scene)
     }
     
     int l = 0;
-    list[l++] = new bvh_node(boxlist, b, 0, 1);
-    list[l++] = new rect_xz(123, 423, 147, 412, 554, light);
+    list[l++] = new hitable_list(boxlist, b);
+    list[l++] = the_scene.lights = new rect_xz(123, 423, 147, 412, 554, light);
     list[l++] = new moving_sphere(vec3(400, 400, 200), vec3(430, 400, 200), 0, 1, 50, brown);
     list[l++] = new sphere(vec3(260, 150, 45), 50, glass);
     list[l++] = new sphere(vec3(0, 150, 145), 50, aluminum);
@@ -323,14 +424,14 @@ void final_test(scene &the_scene)
     for(int j = 0; j < ns; ++j) {
         boxlist2[j] = new sphere(vec3(165 * drand48(), 165 * drand48(), 165 * drand48()), 10, white);
     }
-    list[l++] = new translate(new rotate_y(new bvh_node(boxlist2, ns, 0.0, 1.0), 15), vec3(-100, 270, 395));
+    list[l++] = new translate(new rotate_y(new hitable_list(boxlist2, ns), 15), vec3(-100, 270, 395));
         
     the_scene.cam = new camera(
         vec3(478, 278, -600),       // lookfrom
         vec3(278.0, 278.0, 0.0),    // lookat
         vec3(0.0, 1.0, 0.0),        // camup
         40.0,                       // vfov
-        the_scene.nx/the_scene.ny,  // aspect
+        float(the_scene.nx)/the_scene.ny,  // aspect
         0.0,                        // aperture
         10.0,                       // dist_to_focus
         0.0,                        // t0
@@ -354,7 +455,7 @@ void cornell_spheres(scene &the_scene)
     
     list[i++] = new flip_normals(new rect_yz(0, 555, 0, 555, 555, green));
     list[i++] = new rect_yz(0, 555, 0, 555, 0, red);
-    list[i++] = new rect_xz(113, 443, 127, 432, 554, light);
+    list[i++] = the_scene.lights = new rect_xz(113, 443, 127, 432, 554, light);
     list[i++] = new flip_normals(new rect_xz(0, 555, 0, 555, 555, white));
     list[i++] = new rect_xz(0, 555, 0, 555, 0, white);
     list[i++] = new flip_normals(new rect_xy(0, 555, 0, 555, 555, white));
@@ -366,7 +467,7 @@ void cornell_spheres(scene &the_scene)
         vec3(278.0, 278.0, 0.0),    // lookat
         vec3(0.0, 1.0, 0.0),        // camup
         40.0,                       // vfov
-        the_scene.nx/the_scene.ny,  // aspect
+        float(the_scene.nx)/the_scene.ny,  // aspect
         0.0,                        // aperture
         10.0,                       // dist_to_focus
         0.0,                        // t0
@@ -375,88 +476,76 @@ void cornell_spheres(scene &the_scene)
     the_scene.world = new hitable_list(list, i);
 }
 
-int main()
+// N small emissive spheres over a floor with three diffuse balls. Their
+// total area and power are the same whatever N is.
+template <int N>
+void many_lights(scene &the_scene)
 {
-    scene the_scene;
+    hitable **list = new hitable*[N + 4];
+    hitable **lights = new hitable*[N];
+    int i = 0;
     
-    the_scene.nx = 2*200;
-    the_scene.ny = 2*200;
-    the_scene.ns = 10;
+    material *white = new lambertian(new constant_texture(vec3(0.73, 0.73, 0.73)));
+    material *red = new lambertian(new constant_texture(vec3(0.65, 0.05, 0.05)));
+    material *green = new lambertian(new constant_texture(vec3(0.12, 0.45, 0.15)));
+    material *light = new diffuse_light(new constant_texture(vec3(20, 20, 20)));
+    float radius = 3.0 / sqrt(float(N));
+    
+    list[i++] = new rect_xz(-60, 60, -60, 60, 0, white);
+    list[i++] = new sphere(vec3(-20, 8, 0), 8, red);
+    list[i++] = new sphere(vec3(0, 8, 10), 8, white);
+    list[i++] = new sphere(vec3(20, 8, -5), 8, green);
     
-    std::ofstream myfile("test.ppm");
+    for(int l = 0; l < N; ++l) {
+        vec3 center(-50 + 100 * drand48(), 25 + 10 * drand48(), -50 + 100 * drand48());
+        list[i++] = lights[l] = new sphere(center, radius, light);
+    }
+    
+    the_scene.cam = new camera(
+        vec3(0, 24, -60),           // lookfrom, under the lights and out of view
+        vec3(0.0, 0.0, 0.0),        // lookat
+        vec3(0.0, 1.0, 0.0),        // camup
+        40.0,                       // vfov
+        float(the_scene.nx)/the_scene.ny,  // aspect
+        0.0,                        // aperture
+        10.0,                       // dist_to_focus
+        0.0,                        // t0
+        1.0);                       // t1
+    
+    the_scene.world = new hitable_list(list, i);
+    the_scene.lights = new hitable_list(lights, N);
+}
 
-    myfile << "P3\n" << the_scene.nx << " " << the_scene.ny << "\n255\n";
-    
-    //hitable *world = standard_scene();
-    //hitable *world = random_scene();
-    //hitable *world = two_spheres();
-    //hitable *world = two_perlin_spheres();
-    //hitable *world = earth_sphere();
-    //hitable *world = simple_light();
-    //hitable *world = cornell_box();
-    //hitable *world = cornell_smoke();
-    //hitable *world = cornell_balls();
-    //hitable *world = final_test();
-    
-    /*
-    vec3 lookfrom(3.0, 3.0, 2.0);
-    vec3 lookat(0.0, 0.0, -1.0);
-    vec3 camup(0.0, 1.0, 0.0);
-    float dist_to_focus = (lookfrom - lookat).length();
-    float aperture = 2.0;
-    */
-    
-    /*
-    vec3 lookfrom(13.0, 2.0, 3.0);
-    vec3 lookat(0.0, 2.0, 0.0);
-    vec3 camup(0.0, 1.0, 0.0);
-    float dist_to_focus = 10.0;
-    float aperture = 0.0;
-    */
-    
-    // Cornell box cam
-    /*    
-    vec3 lookfrom(278, 278, -800);
-    vec3 lookat(278.0, 278.0, 0.0);
-    vec3 camup(0.0, 1.0, 0.0);
-    float dist_to_focus = 10.0;
-    float aperture = 0.0;
-    float vfov = 40.0;
-    */
-        
+static const scene_entry scenes[] = {
+    {"cornell_box", cornell_box},
+    {"standard_scene", standard_scene},
+    {"random_scene", random_scene},
+    {"random_scene_sky", random_scene_sky},
+    {"two_spheres", two_spheres},
+    {"two_perlin_spheres", two_perlin_spheres},
+    {"earth_sphere", earth_sphere},
+    {"simple_light", simple_light},
+    {"cornell_smoke", cornell_smoke},
+    {"cornell_balls", cornell_balls},
+    {"final_test", final_test},
+    {"cornell_spheres", cornell_spheres},
+    {"many_lights_1", many_lights<1>},
+    {"many_lights_10", many_lights<10>},
+    {"many_lights_100", many_lights<100>},
+    {"many_lights_1000", many_lights<1000>},
+    {"many_lights_10000", many_lights<10000>}
+};
+
+// Gamma 2, the bottom row of image goes last.
+static void write_ppm(const char *path, const vec3 *image, int nx, int ny)
+{
+    std::ofstream myfile(path);
+
+    myfile << "P3\n" << nx << " " << ny << "\n255\n";
     
-    // Final cam
-    /*
-    vec3 lookfrom(478, 278, -600);
-    vec3 lookat(278.0, 278.0, 0.0);
-    vec3 camup(0.0, 1.0, 0.0);
-    float dist_to_focus = 10.0;
-    float aperture = 0.0;
-    float vfov = 40.0;
-    */
-    
-    cornell_box(the_scene);
-    //final_test(the_scene);
-    //cornell_spheres(the_scene);
-        
-    int rl = 0,
-        rp = 0;
-    for(int j = the_scene.ny - 1; j >= 0; --j) {
-        ++rl;
-        for(int i = 0; i < the_scene.nx; ++i) {
-            ++rp;
-            std::cout << "\rRenderizando pixel " << rp << "/" << the_scene.nx*the_scene.ny << " (linea " << rl << "/" << the_scene.ny << ")";
-            vec3 col(0.0, 0.0, 0.0);
-            
-            for(int s = 0; s < the_scene.ns; ++s) {
-                float u = float(i + drand48()) / float(the_scene.nx);
-                float v = float(j + drand48()) / float(the_scene.ny);
-                
-                ray r = the_scene.cam->get_ray(u, v);
-                col += color(r, the_scene.world, 0);
-            }
-            
-            col /= float(the_scene.ns);
+    for(int j = ny - 1; j >= 0; --j) {
+        for(int i = 0; i < nx; ++i) {
+            vec3 col = image[j * nx + i];
             col = vec3(sqrt(col[0]), sqrt(col[1]), sqrt(col[2]));
             
             int ir = int(255.99 * (col.r() > 1.0 ? 1.0 : col.r()));
@@ -466,6 +555,352 @@ int main()
             myfile << ir << " " << ig << " " << ib << "\n";
         }
     }    
+}
 
-    myfile.close();
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --scene NAME        cornell_box (default), standard_scene, random_scene, random_scene_sky,\n"
+              << "                      two_spheres, two_perlin_spheres, earth_sphere, simple_light,\n"
+              << "                      cornell_smoke, cornell_balls, final_test, cornell_spheres,\n"
+              << "                      many_lights_N with N 1, 10, 100, 1000 or 10000\n"
+              << "  --width N           400\n"
+              << "  --height N          400\n"
+              << "  --spp N             10\n"
+              << "  --mode MODE         scalar (default) or wavefront\n"
+              << "  --threads N         0 for every core\n"
+              << "  --tile N            scalar tile size, 16\n"
+              << "  --packet N          scalar camera ray packets, 4, 8 or 16 (default), 0 for single rays\n"
+              << "  --paths N           wavefront paths in flight, 65536\n"
+              << "  --sort N            wavefront, sort bounced rays in batches of N, 0 (default) to not sort\n"
+              << "  --integrator NAME   path (default) or mis, scalar: light and BSDF sampling with the power heuristic\n"
+              << "                      or bdpt, scalar: bidirectional, camera and light paths joined at every vertex\n"
+              << "  --lights NAME       mis, how a light is picked: uniform (default), power or tree, by power and distance\n"
+              << "  --environment FILE  latitude-longitude image lighting the scene from afar, HDR or not\n"
+              << "  --perf              hardware counters by phase, with IPC and misses per ray, Linux only\n"
+              << "  --timeline FILE     Chrome trace JSON of the scene and BVH builds, tiles and output\n"
+              << "  --stats FILE        JSON report of the render counters, stats.json, needs -DRT_STATS\n"
+              << "  --heatmap KIND      scalar, cost per pixel next to the output: nodes, tests (both need -DRT_STATS) or time\n"
+              << "  --accel METHOD      sah (default), lbvh, lbvh_treelet, sbvh\n"
+              << "  --cache DIR         BVH cache directory, 'none' to disable, cache\n"
+              << "  --seed N            2017\n"
+              << "  --output FILE       test.ppm\n"
+              << "  --bench FILTER      run the kernel microbenchmarks whose name contains FILTER, 'all' for every one\n"
+              << "  --bench-time S      seconds per microbenchmark, 0.5\n"
+              << "  --bench-scenes F    build and render the scenes whose name contains F, 'all' for every one,\n"
+              << "                      with the size, spp, seed and render options given\n"
+              << "  --bench-output BASE scene benchmark results, BASE.csv and BASE.json, bench_scenes\n"
+              << "  --baseline FILE     CSV of an earlier scene benchmark to compare with\n"
+              << "  --threshold PCT     slowdown against the baseline reported as a regression, 5\n"
+              << "  --converge F        error against time of the scenes whose name contains F, 'cornell' for the\n"
+              << "                      Cornell boxes, rendering up to --spp samples with the render options given\n"
+              << "  --label NAME        name of the configuration in the convergence results, default\n"
+              << "  --ref-spp N         samples of the references, 1024\n"
+              << "  --ref-dir DIR       where references are cached, references\n"
+              << "  --converge-output B convergence results appended to B.csv, plots in B.gp, converge\n"
+              << "  --target E          relMSE whose time to reach is reported, 0.01\n";
+}
+
+int main(int argc, char **argv)
+{
+    scene the_scene;
+    render_options options = default_render_options();
+    const scene_entry *entry = &scenes[0];
+    const char *output = "test.ppm";
+    const char *stats_file = "stats.json";
+    const char *timeline_file = nullptr;
+    const char *environment = nullptr;
+    const char *bench_filter = nullptr;
+    double bench_time = 0.5;
+    const char *scene_filter = nullptr;
+    const char *bench_output = "bench_scenes";
+    const char *baseline = nullptr;
+    double threshold = 5.0;
+    converge_options converge;
+    const char *converge_filter = nullptr;
+    converge.label = "default";
+    converge.reference_spp = 1024;
+    converge.reference_dir = "references";
+    converge.output = "converge";
+    converge.target = 0.01;
+    bool count_perf = false;
+    
+    the_scene.nx = 2*200;
+    the_scene.ny = 2*200;
+    the_scene.ns = 10;
+    the_scene.accel = bvh_sah;
+    the_scene.cache_dir = "cache";
+    the_scene.seed = 2017;
+    
+    for(int a = 1; a < argc; ++a) {
+        const char *arg = argv[a];
+        const char *value = a + 1 < argc ? argv[a + 1] : nullptr;
+        bool ok = value != nullptr;
+        
+        if( ok && !strcmp(arg, "--scene") ) {
+            entry = nullptr;
+            for(const scene_entry &e : scenes) {
+                if( !strcmp(e.name, value) )
+                    entry = &e;
+            }
+            ok = entry != nullptr;
+        }
+        else if( ok && !strcmp(arg, "--width") )
+            ok = (the_scene.nx = atoi(value)) > 0;
+        else if( ok && !strcmp(arg, "--height") )
+            ok = (the_scene.ny = atoi(value)) > 0;
+        else if( ok && !strcmp(arg, "--spp") )
+            ok = (the_scene.ns = atoi(value)) > 0;
+        else if( ok && !strcmp(arg, "--threads") )
+            ok = (options.threads = atoi(value)) >= 0;
+        else if( ok && !strcmp(arg, "--tile") )
+            ok = (options.tile_size = atoi(value)) > 0;
+        else if( ok && !strcmp(arg, "--packet") ) {
+            options.packet_size = atoi(value);
+            ok = options.packet_size == 0 || options.packet_size == 4 || options.packet_size == 8 || options.packet_size == 16;
+        }
+        else if( ok && !strcmp(arg, "--sort") )
+            ok = (options.sort_batch = atoi(value)) >= 0;
+        else if( !strcmp(arg, "--perf") ) {
+            count_perf = true;
+            continue;
+        }
+        else if( ok && !strcmp(arg, "--paths") )
+            ok = (options.pool_size = atoi(value)) > 0;
+        else if( ok && !strcmp(arg, "--seed") )
+            the_scene.seed = (unsigned int)strtoul(value, nullptr, 10);
+        else if( ok && !strcmp(arg, "--timeline") )
+            timeline_file = value;
+        else if( ok && !strcmp(arg, "--environment") )
+            environment = value;
+        else if( ok && !strcmp(arg, "--stats") )
+            stats_file = value;
+        else if( ok && !strcmp(arg, "--bench") )
+            bench_filter = value;
+        else if( ok && !strcmp(arg, "--bench-time") )
+            ok = (bench_time = atof(value)) > 0.0;
+        else if( ok && !strcmp(arg, "--bench-scenes") )
+            scene_filter = value;
+        else if( ok && !strcmp(arg, "--bench-output") )
+            bench_output = value;
+        else if( ok && !strcmp(arg, "--baseline") )
+            baseline = value;
+        else if( ok && !strcmp(arg, "--threshold") )
+            ok = (threshold = atof(value)) > 0.0;
+        else if( ok && !strcmp(arg, "--converge") )
+            converge_filter = value;
+        else if( ok && !strcmp(arg, "--label") )
+            converge.label = value;
+        else if( ok && !strcmp(arg, "--ref-spp") )
+            ok = (converge.reference_spp = atoi(value)) > 0;
+        else if( ok && !strcmp(arg, "--ref-dir") )
+            converge.reference_dir = value;
+        else if( ok && !strcmp(arg, "--converge-output") )
+            converge.output = value;
+        else if( ok && !strcmp(arg, "--target") )
+            ok = (converge.target = atof(value)) > 0.0;
+        else if( ok && !strcmp(arg, "--output") )
+            output = value;
+        else if( ok && !strcmp(arg, "--cache") )
+            the_scene.cache_dir = strcmp(value, "none") ? value : nullptr;
+        else if( ok && !strcmp(arg, "--mode") ) {
+            if( !strcmp(value, "scalar") )
+                options.mode = render_scalar;
+            else if( !strcmp(value, "wavefront") )
+                options.mode = render_wavefront;
+            else
+                ok = false;
+        }
+        else if( ok && !strcmp(arg, "--integrator") ) {
+            if( !strcmp(value, "path") )
+                options.integrator = integrator_path;
+            else if( !strcmp(value, "mis") )
+                options.integrator = integrator_mis;
+            else if( !strcmp(value, "bdpt") )
+                options.integrator = integrator_bdpt;
+            else
+                ok = false;
+        }
+        else if( ok && !strcmp(arg, "--lights") ) {
+            if( !strcmp(value, "uniform") )
+                options.light_sampler = light_sampler_uniform;
+            else if( !strcmp(value, "power") )
+                options.light_sampler = light_sampler_power;
+            else if( !strcmp(value, "tree") )
+                options.light_sampler = light_sampler_tree;
+            else
+                ok = false;
+        }
+        else if( ok && !strcmp(arg, "--heatmap") ) {
+            if( !strcmp(value, "time") )
+                options.heatmap = heatmap_time;
+#ifdef RT_STATS
+            else if( !strcmp(value, "nodes") )
+                options.heatmap = heatmap_nodes;
+            else if( !strcmp(value, "tests") )
+                options.heatmap = heatmap_tests;
+#endif
+            else
+                ok = false;
+        }
+        else if( ok && !strcmp(arg, "--accel") ) {
+            if( !strcmp(value, "sah") )
+                the_scene.accel = bvh_sah;
+            else if( !strcmp(value, "lbvh") )
+                the_scene.accel = bvh_lbvh;
+            else if( !strcmp(value, "lbvh_treelet") )
+                the_scene.accel = bvh_lbvh_treelet;
+            else if( !strcmp(value, "sbvh") )
+                the_scene.accel = bvh_sbvh;
+            else
+                ok = false;
+        }
+        else
+            ok = false;
+        
+        if( !ok ) {
+            std::cerr << "Invalid option: " << arg << (value ? " " : "") << (value ? value : "") << "\n";
+            usage(argv[0]);
+            return 1;
+        }
+        ++a;
+    }
+    
+    // Before any build: the BVH builders and the environment tables are parallel too.
+    set_thread_limit(options.threads);
+    
+    if( options.integrator != integrator_path && options.mode == render_wavefront )
+        std::cerr << "The MIS and BDPT integrators need --mode scalar, the wavefront renderer samples BSDFs only\n";
+    
+    if( bench_filter ) {
+        if( !run_benchmarks(strcmp(bench_filter, "all") ? bench_filter : nullptr, bench_time) ) {
+            std::cerr << "No benchmark matches " << bench_filter << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    
+    if( scene_filter ) {
+        scene_bench_options bench;
+        bench.nx = the_scene.nx;
+        bench.ny = the_scene.ny;
+        bench.ns = the_scene.ns;
+        bench.seed = the_scene.seed;
+        bench.accel = the_scene.accel;
+        bench.render = options;
+        bench.output = bench_output;
+        bench.baseline = baseline;
+        bench.threshold = threshold / 100.0;
+        
+        if( !run_scene_benchmarks(scenes, int(sizeof(scenes) / sizeof(scenes[0])), strcmp(scene_filter, "all") ? scene_filter : nullptr, bench) )
+            return 1;
+        return 0;
+    }
+    
+    if( converge_filter ) {
+        converge.nx = the_scene.nx;
+        converge.ny = the_scene.ny;
+        converge.max_spp = the_scene.ns;
+        converge.seed = the_scene.seed;
+        converge.accel = the_scene.accel;
+        converge.render = options;
+        
+        if( !run_convergence(scenes, int(sizeof(scenes) / sizeof(scenes[0])), strcmp(converge_filter, "all") ? converge_filter : nullptr, converge) )
+            return 1;
+        return 0;
+    }
+    
+    if( count_perf )
+        enable_phase_counters();
+    if( timeline_file ) {
+        enable_timeline();
+        name_timeline_thread("main");
+    }
+    
+    seed_drand48(the_scene.seed);
+    
+    {
+        perf_phase_scope phase(perf_phase_scene);
+        timeline_scope span(entry->name, "scene");
+        entry->build(the_scene);
+        if( environment )
+            the_scene.environment = environment_file(environment);
+    }
+    
+    compile_stats cs;
+    {
+        perf_phase_scope phase(perf_phase_bvh);
+        the_scene.world = compile_world(the_scene.world, the_scene.cam->time0, the_scene.cam->time1, 
+            the_scene.accel, the_scene.cache_dir, &cs);
+        the_scene.lights = make_light_sampler(the_scene.lights, the_scene.cam->time0, the_scene.cam->time1, options.light_sampler);
+    }
+    std::cerr << "Scene: " << cs << "\n";
+    
+    vec3 *image = new vec3[the_scene.nx * the_scene.ny];
+    account_memory(memory_scratch, (long long)the_scene.nx * the_scene.ny * sizeof(vec3), 1);
+    
+    std::vector<float> heat;
+    std::vector<tile_record> tiles;
+    render_aov aov = { nullptr, &tiles };
+    
+    if( options.heatmap != heatmap_none ) {
+        if( options.mode == render_wavefront )
+            std::cerr << "The heatmap needs --mode scalar, not written\n";
+        heat.assign(the_scene.nx * the_scene.ny, 0.0f);
+        aov.heat = heat.data();
+    }
+    
+    reset_stats();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t rays;
+    {
+        timeline_scope span("render", "render");
+        rays = render(the_scene, options, image, &aov);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    {
+        perf_phase_scope phase(perf_phase_output);
+        timeline_scope span("write_output", "output");
+        write_ppm(output, image, the_scene.nx, the_scene.ny);
+        
+        if( options.heatmap != heatmap_none && options.mode == render_scalar ) {
+            std::string base = output;
+            size_t dot = base.find_last_of('.');
+            if( dot != std::string::npos && base.find_first_of("/\\", dot) == std::string::npos )
+                base.erase(dot);
+            
+            if( !write_heatmap(base, heat.data(), the_scene.nx, the_scene.ny, tiles) )
+                std::cerr << "Could not write the heatmap " << base << ".heat.*\n";
+        }
+    }
+    
+    delete [] image;
+    account_memory(memory_scratch, -(long long)the_scene.nx * the_scene.ny * (long long)sizeof(vec3), -1);
+    
+    memory_report memory = collect_memory();
+    std::cerr << "Memory: " << memory << "\n";
+    
+    if( count_perf )
+        print_perf_report(std::cerr, collect_phase_counters(), rays);
+    
+    if( timeline_file && !write_timeline(timeline_file) )
+        std::cerr << "Could not write the timeline " << timeline_file << "\n";
+    
+#ifdef RT_STATS
+    trace_stats trace = collect_stats();
+    std::cerr << "Trace: " << trace << "\n";
+    
+    std::ofstream report(stats_file);
+    report << "{\n  \"scene\": \"" << entry->name << "\", \"width\": " << the_scene.nx << ", \"height\": " << the_scene.ny
+           << ", \"spp\": " << the_scene.ns << ",\n  \"mode\": \"" << (options.mode == render_wavefront ? "wavefront" : "scalar")
+           << "\", \"threads\": " << hardware_threads() << ", \"render_seconds\": " << seconds << ",\n  \"stats\": ";
+    write_json(report, trace);
+    report << ",\n  \"memory\": ";
+    write_json(report, memory);
+    report << "\n}\n";
+#else
+    (void)stats_file;
+    (void)seconds;
+#endif
 }
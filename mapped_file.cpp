@@ -0,0 +1,102 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool mapped_file::open(const char *path)
+{
+    close();
+
+    HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if( f == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER length;
+    if( !GetFileSizeEx(f, &length) || length.QuadPart == 0 ) {
+        CloseHandle(f);
+        return false;
+    }
+
+    HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    if( m == NULL ) {
+        CloseHandle(f);
+        return false;
+    }
+
+    void *view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if( view == NULL ) {
+        CloseHandle(m);
+        CloseHandle(f);
+        return false;
+    }
+
+    file = f;
+    mapping = m;
+    data = static_cast<const unsigned char *>(view);
+    size = size_t(length.QuadPart);
+
+    return true;
+}
+
+void mapped_file::close()
+{
+    if( data )
+        UnmapViewOfFile(data);
+    if( mapping )
+        CloseHandle(mapping);
+    if( file )
+        CloseHandle(file);
+
+    data = nullptr;
+    size = 0;
+    file = mapping = nullptr;
+}
+
+#else
+
+bool mapped_file::open(const char *path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if( fd < 0 )
+        return false;
+
+    struct stat st;
+    if( fstat(fd, &st) != 0 || st.st_size == 0 ) {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if( view == MAP_FAILED )
+        return false;
+
+    data = static_cast<const unsigned char *>(view);
+    size = size_t(st.st_size);
+    mapping = view;
+
+    return true;
+}
+
+void mapped_file::close()
+{
+    if( mapping )
+        munmap(mapping, size);
+
+    data = nullptr;
+    size = 0;
+    file = mapping = nullptr;
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <stddef.h>
+
+// Read-only memory mapping of a whole file.
+class mapped_file
+{
+    public:
+        mapped_file() : data(nullptr), size(0), file(nullptr), mapping(nullptr) {}
+        ~mapped_file() { close(); }
+
+        bool open(const char *path);
+        void close();
+
+        const unsigned char *data;
+        size_t              size;
+
+    private:
+        mapped_file(const mapped_file &);
+        mapped_file &operator=(const mapped_file &);
+
+        void    *file,
+                *mapping;
+};
+
+#endif // __MAPPED_FILE_H__
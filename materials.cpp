@@ -1,6 +1,27 @@
 #include "materials.h"
 #include "rangen.h"
 
+// The points of the ball along the unit direction d lie between t0 and t1,
+// roots of |t d - center|^2 = radius^2. Integrating t^2 dt over them gives
+// the share of the ball's volume in the solid angle around d.
+float ball_direction_pdf(const vec3 &center, float radius, const vec3 &direction)
+{
+    float c = dot(unit_vector(direction), center);
+    float discriminant = c * c - (1.0 - radius * radius);
+    
+    if( discriminant < 0.0 )
+        return 0.0;
+    
+    float root = sqrt(discriminant),
+          t0 = c - root > 0.0 ? c - root : 0.0,
+          t1 = c + root;
+    
+    if( t1 <= 0.0 )
+        return 0.0;
+    
+    return (t1 * t1 * t1 - t0 * t0 * t0) / (4.0 * kPI * radius * radius * radius);
+}
+
 //
 // DIELECTRIC
 //
@@ -12,7 +33,7 @@ float schlick(float cosine, float ref_idx)
     return r0 + (1.0 - r0) * pow((1.0 - cosine), 5);
 }
 
-bool dielectric::scatter(const ray& r_in, const hit_record& rec, vec3& attenuation, ray& scattered) const
+bool dielectric::sample(const ray &r_in, const hit_record &rec, bsdf_sample &s) const
 {
     vec3 outward_normal;
     vec3 reflected = reflect(r_in.direction(), rec.normal);
@@ -20,7 +41,8 @@ bool dielectric::scatter(const ray& r_in, const hit_record& rec, vec3& attenuati
     vec3 refracted;
     float reflect_prob;
     float cosine;
-    attenuation = vec3(1.0, 1.0, 1.0);
+    s.value = vec3(1.0, 1.0, 1.0);
+    s.pdf = 0.0;
 
     if(dot(r_in.direction(), rec.normal) > 0.0) {
         outward_normal = -rec.normal;
@@ -40,9 +62,9 @@ bool dielectric::scatter(const ray& r_in, const hit_record& rec, vec3& attenuati
         reflect_prob = 1.0;
         
     if(drand48() < reflect_prob)
-        scattered = ray(rec.p, reflected);
+        s.direction = reflected;
     else
-        scattered = ray(rec.p, refracted);
+        s.direction = refracted;
         
     return true;
 }
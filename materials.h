@@ -3,30 +3,99 @@
 
 #include "hitables.h"
 #include "textures.h"
+#include "onb.h"
+
+// Lets the wavefront renderer queue hits by material and shade each queue
+// without virtual calls.
+enum material_kind
+{
+    material_lambertian,
+    material_metal,
+    material_dielectric,
+    material_isotropic,
+    material_diffuse_light,
+    material_other,
+    material_kinds
+};
+
+// A direction picked by a material. value is the BSDF times the cosine
+// toward it and pdf its density per unit solid angle, so the path weight is
+// value / pdf. Mirrors and glass pick from delta distributions: their pdf is
+// 0 and value is the weight itself.
+struct bsdf_sample
+{
+    vec3    direction,
+            value;
+    float   pdf;
+    
+    vec3 weight() const { return pdf > 0.0 ? value / pdf : value; }
+};
 
 class material
 {
     public:
-        virtual bool scatter(const ray &r_in, const hit_record &rec, vec3 &attenuation, ray &scattered) const = 0;
+        RT_MEMORY_CATEGORY(memory_materials)
+        
+        material(material_kind k = material_other) : kind(k) {}
+        
+        // Picks the direction the path goes on in, false when it is absorbed.
+        virtual bool sample(const ray &r_in, const hit_record &rec, bsdf_sample &s) const = 0;
+        
+        // What sample() would give for direction: the BSDF times the cosine,
+        // and the density it is picked with. Both 0 for delta distributions.
+        virtual vec3 eval(const ray &r_in, const hit_record &rec, const vec3 &direction) const { return vec3(0.0, 0.0, 0.0); }
+        virtual float pdf(const ray &r_in, const hit_record &rec, const vec3 &direction) const { return 0.0; }
+        
         virtual vec3 emitted(float u, float v, const vec3 &p) const { return vec3(0.0, 0.0, 0.0); }
+        // Of emitted() over the whole (u, v) square.
+        virtual vec3 average_emitted(const vec3 &p) const { return emitted(0.5, 0.5, p); }
         virtual ~material() {};
+        
+        // sample() for the integrators that just follow it: the next ray and the path weight.
+        bool scatter(const ray &r_in, const hit_record &rec, vec3 &attenuation, ray &scattered) const
+        {
+            bsdf_sample s;
+            
+            if( !sample(r_in, rec, s) )
+                return false;
+            
+            attenuation = s.weight();
+            scattered = ray(rec.p, s.direction, r_in.time());
+            return true;
+        }
+        
+        material_kind kind;
 };
 
+// Density per unit solid angle of the direction of center + radius * random_in_unit_sphere(),
+// center being a unit vector and radius at most 1.
+float ball_direction_pdf(const vec3 &center, float radius, const vec3 &direction);
+
 //
 // LAMBERTIAN
 //
 
+// Cosine weighted, the value and the pdf cancel out but for the albedo.
 class lambertian : public material
 {
     public:
-        lambertian(texture *a) : albedo(a) {}
-        virtual bool scatter(const ray &r_in, const hit_record &rec, vec3 &attenuation, ray &scattered) const
+        lambertian(texture *a) : material(material_lambertian), albedo(a) {}
+        virtual bool sample(const ray &r_in, const hit_record &rec, bsdf_sample &s) const
         {
-            vec3 target = rec.p + rec.normal + random_in_unit_sphere();
-            scattered = ray(rec.p, target - rec.p);
-            attenuation = albedo->value(rec.u, rec.v, rec.p);
+            s.direction = onb(rec.normal).local(random_cosine_direction());
+            s.pdf = dot(s.direction, rec.normal) / kPI;
+            s.value = albedo->value(rec.u, rec.v, rec.p) * s.pdf;
             
-            return true;
+            return s.pdf > 0.0;
+        }
+        virtual vec3 eval(const ray &r_in, const hit_record &rec, const vec3 &direction) const
+        {
+            return albedo->value(rec.u, rec.v, rec.p) * pdf(r_in, rec, direction);
+        }
+        virtual float pdf(const ray &r_in, const hit_record &rec, const vec3 &direction) const
+        {
+            float cosine = dot(unit_vector(direction), rec.normal);
+            return cosine > 0.0 ? cosine / kPI : 0.0;
         }
         
         texture *albedo;
@@ -36,17 +105,30 @@ class lambertian : public material
 // METAL
 //
 
+// The mirror direction moved by a random point of the fuzz ball, directions
+// below the surface are absorbed. A delta distribution without fuzz.
 class metal : public material
 {
     public:
-        metal(const vec3 &a, float f) : albedo(a) { fuzz = f < 1.0 ? f : 1.0; }
-        virtual bool scatter(const ray &r_in, const hit_record &rec, vec3 &attenuation, ray &scattered) const
+        metal(const vec3 &a, float f) : material(material_metal), albedo(a) { fuzz = f < 1.0 ? f : 1.0; }
+        virtual bool sample(const ray &r_in, const hit_record &rec, bsdf_sample &s) const
         {
             vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
-            scattered = ray(rec.p, reflected + fuzz * random_in_unit_sphere());
-            attenuation = albedo;
+            s.direction = reflected + fuzz * random_in_unit_sphere();
+            s.pdf = fuzz > 0.0 ? ball_direction_pdf(reflected, fuzz, s.direction) : 0.0;
+            s.value = s.pdf > 0.0 ? albedo * s.pdf : albedo;
             
-            return ( dot(scattered.direction(), rec.normal) > 0.0 );
+            return ( dot(s.direction, rec.normal) > 0.0 );
+        }
+        virtual vec3 eval(const ray &r_in, const hit_record &rec, const vec3 &direction) const
+        {
+            return albedo * pdf(r_in, rec, direction);
+        }
+        virtual float pdf(const ray &r_in, const hit_record &rec, const vec3 &direction) const
+        {
+            if( fuzz <= 0.0 || dot(direction, rec.normal) <= 0.0 )
+                return 0.0;
+            return ball_direction_pdf(reflect(unit_vector(r_in.direction()), rec.normal), fuzz, direction);
         }
         
         vec3 albedo;
@@ -57,11 +139,12 @@ class metal : public material
 // DIELECTRIC
 //
 
+// Reflects or refracts with the Schlick Fresnel odds, a delta distribution.
 class dielectric : public material
 {
     public:
-        dielectric(float ri) : ref_idx(ri) {}        
-        virtual bool scatter(const ray& r_in, const hit_record& rec, vec3& attenuation, ray& scattered) const;
+        dielectric(float ri) : material(material_dielectric), ref_idx(ri) {}        
+        virtual bool sample(const ray &r_in, const hit_record &rec, bsdf_sample &s) const;
         
         float ref_idx;
 };
@@ -73,9 +156,9 @@ class dielectric : public material
 class diffuse_light : public material
 {
     public:
-        diffuse_light() {}
-        diffuse_light(texture *a) : emit(a) {}
-        virtual bool scatter(const ray &r_in, const hit_record &rec, vec3 &attenuation, ray &scattered) const
+        diffuse_light() : material(material_diffuse_light) {}
+        diffuse_light(texture *a) : material(material_diffuse_light), emit(a) {}
+        virtual bool sample(const ray &r_in, const hit_record &rec, bsdf_sample &s) const
         {
             return false;
         }
@@ -83,6 +166,10 @@ class diffuse_light : public material
         {
             return emit->value(u, v, p);
         }
+        virtual vec3 average_emitted(const vec3 &p) const
+        {
+            return emit->average(p);
+        }
         
         texture *emit;
 };
@@ -91,17 +178,27 @@ class diffuse_light : public material
 // ISOTROPIC
 //
 
+// Phase function of participating media, every direction as likely.
 class isotropic : public material
 {
     public:
-        isotropic(texture *a) : albedo(a) {}
-        virtual bool scatter(const ray &r_in, const hit_record &rec, vec3 &attenuation, ray &scattered) const
+        isotropic(texture *a) : material(material_isotropic), albedo(a) {}
+        virtual bool sample(const ray &r_in, const hit_record &rec, bsdf_sample &s) const
         {
-            scattered = ray(rec.p, random_in_unit_sphere());
-            attenuation = albedo->value(rec.u, rec.v, rec.p);
+            s.direction = random_in_unit_sphere();
+            s.pdf = 1.0 / (4.0 * kPI);
+            s.value = albedo->value(rec.u, rec.v, rec.p) * s.pdf;
             
             return true;
         }
+        virtual vec3 eval(const ray &r_in, const hit_record &rec, const vec3 &direction) const
+        {
+            return albedo->value(rec.u, rec.v, rec.p) / (4.0 * kPI);
+        }
+        virtual float pdf(const ray &r_in, const hit_record &rec, const vec3 &direction) const
+        {
+            return 1.0 / (4.0 * kPI);
+        }
         
         texture *albedo;
 };
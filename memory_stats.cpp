@@ -0,0 +1,112 @@
+#include "memory_stats.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+
+static const char *category_names[memory_categories] = {
+    "bvh", "primitives", "instances", "materials", "textures", "perlin", "scratch"
+};
+
+static std::atomic<long long> bytes[memory_categories],
+                              counts[memory_categories],
+                              peaks[memory_categories];
+
+void account_memory(memory_category category, long long n, long long count)
+{
+    long long now = bytes[category] += n;
+    counts[category] += count;
+
+    long long peak = peaks[category];
+    while( now > peak && !peaks[category].compare_exchange_weak(peak, now) )
+        ;
+}
+
+void *allocate_accounted(memory_category category, size_t size)
+{
+    account_memory(category, (long long)size, 1);
+    return ::operator new(size);
+}
+
+void free_accounted(memory_category category, void *p, size_t size)
+{
+    account_memory(category, -(long long)size, -1);
+    ::operator delete(p);
+}
+
+memory_report collect_memory()
+{
+    memory_report r;
+
+    for(int c = 0; c < memory_categories; ++c) {
+        r.bytes[c] = bytes[c];
+        r.count[c] = counts[c];
+        r.peak_bytes[c] = peaks[c];
+    }
+    r.peak_rss_mb = peak_rss_mb();
+
+    return r;
+}
+
+std::ostream& operator<<(std::ostream &os, const memory_report &r)
+{
+    long long scene = 0;
+
+    for(int c = 0; c < memory_categories; ++c) {
+        // Scratch is gone after the render, its peak is what matters.
+        long long b = c == memory_scratch ? r.peak_bytes[c] : r.bytes[c];
+        os << (c > 0 ? ", " : "") << category_names[c] << " " << b / 1024.0 << " KB";
+        if( c != memory_bvh && c != memory_scratch && c != memory_perlin )
+            os << " (" << r.count[c] << ")";
+        if( c != memory_scratch )
+            scene += b;
+    }
+
+    if( r.count[memory_primitives] > 0 ) {
+        os << ", " << double(scene) / r.count[memory_primitives] << " bytes per primitive, "
+           << double(r.bytes[memory_bvh]) / r.count[memory_primitives] << " of them BVH";
+    }
+
+    if( r.peak_rss_mb >= 0.0 )
+        os << ", peak RSS " << r.peak_rss_mb << " MB";
+
+    return os;
+}
+
+void write_json(std::ostream &os, const memory_report &r)
+{
+    os << "{";
+    for(int c = 0; c < memory_categories; ++c) {
+        os << (c > 0 ? "," : "") << "\n    \"" << category_names[c] << "\": {\"bytes\": " << r.bytes[c]
+           << ", \"count\": " << r.count[c] << ", \"peak_bytes\": " << r.peak_bytes[c] << "}";
+    }
+    os << ",\n    \"peak_rss_mb\": " << r.peak_rss_mb << "\n}";
+}
+
+//
+// RESIDENT SET
+//
+
+// The memory in use when it is called stays in the next peak.
+void reset_peak_rss()
+{
+#ifdef __linux__
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+#endif
+}
+
+double peak_rss_mb()
+{
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while( std::getline(status, line) ) {
+        if( !line.compare(0, 6, "VmHWM:") )
+            return atof(line.c_str() + 6) / 1024.0;
+    }
+#endif
+    return -1.0;
+}
@@ -0,0 +1,54 @@
+#ifndef __MEMORY_STATS_H__
+#define __MEMORY_STATS_H__
+
+#include <stddef.h>
+#include <iostream>
+
+enum memory_category
+{
+    memory_bvh,         // Flattened nodes and primitive references.
+    memory_primitives,
+    memory_instances,   // Instances, media and hitable_lists, with their pointer arrays.
+    memory_materials,
+    memory_textures,    // Texture objects and the pixels of image textures.
+    memory_perlin,      // The shared noise tables.
+    memory_scratch,     // Render buffers, hit_records and paths.
+    memory_categories
+};
+
+// Adds bytes and objects, negative when they are freed. Always on, the hooks
+// only run while building scenes and setting renders up.
+void account_memory(memory_category category, long long bytes, long long count);
+
+// Allocation and release of objects that are accounted in category.
+void *allocate_accounted(memory_category category, size_t size);
+void free_accounted(memory_category category, void *p, size_t size);
+
+// Puts a class and the ones derived from it in a category: objects made with
+// new are counted with their full size.
+#define RT_MEMORY_CATEGORY(category) \
+    static void *operator new(size_t size) { return allocate_accounted(category, size); } \
+    static void operator delete(void *p, size_t size) { free_accounted(category, p, size); }
+
+struct memory_report
+{
+    long long   bytes[memory_categories],
+                count[memory_categories],
+                peak_bytes[memory_categories];
+    double      peak_rss_mb;    // -1 where it can not be measured.
+};
+
+memory_report collect_memory();
+
+// Bytes per category, then per primitive for the scene and its BVHs.
+std::ostream& operator<<(std::ostream &os, const memory_report &r);
+
+// An object with bytes, count and peak_bytes per category, and peak_rss_mb.
+void write_json(std::ostream &os, const memory_report &r);
+
+// Peak resident set size of the process, as far as the system allows. Linux
+// only, where it can also be restarted.
+void reset_peak_rss();
+double peak_rss_mb();
+
+#endif // __MEMORY_STATS_H__
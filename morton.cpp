@@ -0,0 +1,46 @@
+#include "morton.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+// Every chunk counts its own digits and scatters into its own slots, so the
+// passes stay stable with any number of threads.
+void radix_sort(std::vector<uint64_t> &keys, std::vector<int> &values, int bits, int threads)
+{
+    int n = int(keys.size());
+    int chunks = std::max(1, threads);
+    std::vector<uint64_t> tmp_keys(n);
+    std::vector<int> tmp_values(n);
+    std::vector<int> hist(chunks * 256);
+
+    for(int shift = 0; shift < bits; shift += 8) {
+        std::fill(hist.begin(), hist.end(), 0);
+
+        parallel_chunks(0, n, chunks, [&](int c, int begin, int end) {
+            int *h = &hist[c * 256];
+            for(int i = begin; i < end; ++i)
+                ++h[(keys[i] >> shift) & 255];
+        });
+
+        int sum = 0;
+        for(int d = 0; d < 256; ++d) {
+            for(int c = 0; c < chunks; ++c) {
+                int count = hist[c * 256 + d];
+                hist[c * 256 + d] = sum;
+                sum += count;
+            }
+        }
+
+        parallel_chunks(0, n, chunks, [&](int c, int begin, int end) {
+            int *h = &hist[c * 256];
+            for(int i = begin; i < end; ++i) {
+                int dst = h[(keys[i] >> shift) & 255]++;
+                tmp_keys[dst] = keys[i];
+                tmp_values[dst] = values[i];
+            }
+        });
+
+        keys.swap(tmp_keys);
+        values.swap(tmp_values);
+    }
+}
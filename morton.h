@@ -0,0 +1,54 @@
+#ifndef __MORTON_H__
+#define __MORTON_H__
+
+#include <stdint.h>
+#include <vector>
+
+#include "vec3.h"
+#include "aabb.h"
+
+// Spread the low 10 bits of v so there are two zero bits between each of them.
+inline uint64_t expand_bits_10(uint64_t v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8))  & 0x0300f00f;
+    v = (v | (v << 4))  & 0x030c30c3;
+    v = (v | (v << 2))  & 0x09249249;
+    return v;
+}
+
+// Same, for the low 21 bits.
+inline uint64_t expand_bits_21(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x001f00000000ffffull;
+    v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+    v = (v | (v << 8))  & 0x100f00f00f00f00full;
+    v = (v | (v << 4))  & 0x10c30c30c30c30c3ull;
+    v = (v | (v << 2))  & 0x1249249249249249ull;
+    return v;
+}
+
+// Code of a point in the unit cube, 30 or 63 bits.
+inline uint64_t morton_code(const vec3 &p, int bits)
+{
+    float scale = bits == 63 ? float((1 << 21) - 1) : float((1 << 10) - 1);
+    uint64_t q[3];
+
+    for(int a = 0; a < 3; ++a) {
+        float c = ffmin(ffmax(p[a], 0.0f), 1.0f);
+        q[a] = uint64_t(c * scale);
+    }
+
+    if( bits == 63 )
+        return (expand_bits_21(q[0]) << 2) | (expand_bits_21(q[1]) << 1) | expand_bits_21(q[2]);
+    else
+        return (expand_bits_10(q[0]) << 2) | (expand_bits_10(q[1]) << 1) | expand_bits_10(q[2]);
+}
+
+// LSD radix sort of (key, value) pairs on the low bits of the keys, eight
+// bits per pass, on up to threads threads.
+void radix_sort(std::vector<uint64_t> &keys, std::vector<int> &values, int bits, int threads);
+
+#endif // __MORTON_H__
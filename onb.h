@@ -0,0 +1,25 @@
+#ifndef __ONB_H__
+#define __ONB_H__
+
+#include "vec3.h"
+
+// Orthonormal basis with w along a given direction, to turn directions
+// sampled around the z axis into world space.
+class onb
+{
+    public:
+        onb(const vec3 &n)
+        {
+            w = unit_vector(n);
+            vec3 a = fabs(w.x()) > 0.9 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+            v = unit_vector(cross(w, a));
+            u = cross(w, v);
+        }
+        
+        vec3 local(float a, float b, float c) const { return a*u + b*v + c*w; }
+        vec3 local(const vec3 &a) const { return a.x()*u + a.y()*v + a.z()*w; }
+        
+        vec3 u, v, w;
+};
+
+#endif // __ONB_H__
@@ -0,0 +1,213 @@
+#ifndef __PACKET_H__
+#define __PACKET_H__
+
+#include "ray.h"
+#include "aabb.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RT_SSE
+#endif
+
+const int kPacketSize = 16;         // Widest packet, 4 and 8 wide ones use the first lanes.
+const int kPacketMinActive = 3;     // With fewer rays left a BVH subtree is traced one ray at a time.
+
+typedef unsigned int packet_mask;   // Bit i for lane i.
+
+//
+// FLOAT4
+//
+
+// Four lanes of a packet. SSE when the compiler has it, plain loops otherwise.
+struct float4
+{
+#ifdef RT_SSE
+    __m128  v;
+
+    float4() {}
+    float4(__m128 x) : v(x) {}
+    explicit float4(float s) : v(_mm_set1_ps(s)) {}
+
+    static float4 load(const float *p) { return _mm_load_ps(p); }
+    void store(float *p) const { _mm_store_ps(p, v); }
+#else
+    float   v[4];
+
+    float4() {}
+    explicit float4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+
+    static float4 load(const float *p) { float4 r; for(int i = 0; i < 4; ++i) r.v[i] = p[i]; return r; }
+    void store(float *p) const { for(int i = 0; i < 4; ++i) p[i] = v[i]; }
+#endif
+};
+
+#ifdef RT_SSE
+inline float4 operator+(const float4 &a, const float4 &b) { return _mm_add_ps(a.v, b.v); }
+inline float4 operator-(const float4 &a, const float4 &b) { return _mm_sub_ps(a.v, b.v); }
+inline float4 operator*(const float4 &a, const float4 &b) { return _mm_mul_ps(a.v, b.v); }
+inline float4 operator/(const float4 &a, const float4 &b) { return _mm_div_ps(a.v, b.v); }
+inline float4 min4(const float4 &a, const float4 &b) { return _mm_min_ps(a.v, b.v); }
+inline float4 max4(const float4 &a, const float4 &b) { return _mm_max_ps(a.v, b.v); }
+inline float4 sqrt4(const float4 &a) { return _mm_sqrt_ps(a.v); }
+
+// Lanes where a < b, as the low four bits of a mask.
+inline packet_mask less4(const float4 &a, const float4 &b) { return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)); }
+#else
+#define RT_FLOAT4_OP(name, expr) \
+    inline float4 name(const float4 &a, const float4 &b) { float4 r; for(int i = 0; i < 4; ++i) r.v[i] = expr; return r; }
+
+RT_FLOAT4_OP(operator+, a.v[i] + b.v[i])
+RT_FLOAT4_OP(operator-, a.v[i] - b.v[i])
+RT_FLOAT4_OP(operator*, a.v[i] * b.v[i])
+RT_FLOAT4_OP(operator/, a.v[i] / b.v[i])
+RT_FLOAT4_OP(min4, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+RT_FLOAT4_OP(max4, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+
+#undef RT_FLOAT4_OP
+
+inline float4 sqrt4(const float4 &a) { float4 r; for(int i = 0; i < 4; ++i) r.v[i] = sqrtf(a.v[i]); return r; }
+
+inline packet_mask less4(const float4 &a, const float4 &b)
+{
+    packet_mask m = 0;
+    for(int i = 0; i < 4; ++i)
+        m |= (a.v[i] < b.v[i]) << i;
+    return m;
+}
+#endif
+
+//
+// RAY PACKET
+//
+
+// Up to 16 rays as a structure of arrays. Fill the lanes with set(), then
+// call finish() before tracing. Traversal shrinks tmax of the lanes that hit.
+struct ray_packet
+{
+    alignas(16) float   org[3][kPacketSize],
+                        dir[3][kPacketSize],
+                        inv_dir[3][kPacketSize],
+                        tmax[kPacketSize],
+                        time[kPacketSize];
+    float               tmin;
+    int                 size;       // Lanes in use, a multiple of 4.
+
+    // Set by finish(): whether every direction has the same signs, so the
+    // packet can be traced together, and the bounds for interval culling.
+    bool                coherent;
+    int                 dir_neg[3];
+    float               org_lo[3], org_hi[3],
+                        inv_lo[3], inv_hi[3];
+
+    void set(int i, const ray &r, float t_max)
+    {
+        for(int a = 0; a < 3; ++a) {
+            org[a][i] = r.origin()[a];
+            dir[a][i] = r.direction()[a];
+        }
+        tmax[i] = t_max;
+        time[i] = r.time();
+    }
+
+    ray get(int i) const
+    {
+        return ray(vec3(org[0][i], org[1][i], org[2][i]), vec3(dir[0][i], dir[1][i], dir[2][i]), time[i]);
+    }
+
+    // Lanes past count copy the first one, so they can be computed with the rest and ignored.
+    void finish(int count)
+    {
+        size = (count + 3) & ~3;
+
+        for(int i = count; i < size; ++i) {
+            for(int a = 0; a < 3; ++a) {
+                org[a][i] = org[a][0];
+                dir[a][i] = dir[a][0];
+            }
+            tmax[i] = tmax[0];
+            time[i] = time[0];
+        }
+
+        coherent = true;
+
+        for(int a = 0; a < 3; ++a) {
+            dir_neg[a] = dir[a][0] < 0.0f;
+            org_lo[a] = inv_lo[a] = FLT_MAX;
+            org_hi[a] = inv_hi[a] = -FLT_MAX;
+
+            for(int i = 0; i < size; ++i) {
+                inv_dir[a][i] = 1.0f / dir[a][i];
+
+                if( (dir[a][i] < 0.0f) != bool(dir_neg[a]) || dir[a][i] == 0.0f )
+                    coherent = false;
+
+                org_lo[a] = ffmin(org_lo[a], org[a][i]);
+                org_hi[a] = ffmax(org_hi[a], org[a][i]);
+                inv_lo[a] = ffmin(inv_lo[a], inv_dir[a][i]);
+                inv_hi[a] = ffmax(inv_hi[a], inv_dir[a][i]);
+            }
+        }
+    }
+
+    // Interval arithmetic over the whole packet: true when no ray in it can hit
+    // the box. Only meaningful for coherent packets.
+    bool culled(const aabb &box, float packet_tmax) const
+    {
+        float tnear = tmin,
+              tfar = packet_tmax;
+
+        for(int a = 0; a < 3; ++a) {
+            float near_plane = dir_neg[a] ? box._max[a] : box._min[a];
+            float far_plane = dir_neg[a] ? box._min[a] : box._max[a];
+
+            // Smallest possible entry and largest possible exit along the axis.
+            float n0 = (near_plane - org_hi[a]) * inv_lo[a], n1 = (near_plane - org_hi[a]) * inv_hi[a],
+                  n2 = (near_plane - org_lo[a]) * inv_lo[a], n3 = (near_plane - org_lo[a]) * inv_hi[a];
+            float f0 = (far_plane - org_hi[a]) * inv_lo[a], f1 = (far_plane - org_hi[a]) * inv_hi[a],
+                  f2 = (far_plane - org_lo[a]) * inv_lo[a], f3 = (far_plane - org_lo[a]) * inv_hi[a];
+
+            tnear = ffmax(tnear, ffmin(ffmin(n0, n1), ffmin(n2, n3)));
+            tfar = ffmin(tfar, ffmax(ffmax(f0, f1), ffmax(f2, f3)));
+        }
+
+        return tnear > tfar;
+    }
+
+    // Slab test of every lane in mask, four at a time. Returns the lanes that hit.
+    packet_mask box_hit(const aabb &box, packet_mask mask) const
+    {
+        packet_mask hits = 0;
+
+        for(int g = 0; g < size; g += 4) {
+            if( !((mask >> g) & 15) )
+                continue;
+
+            float4 tnear(tmin),
+                   tfar = float4::load(tmax + g);
+
+            for(int a = 0; a < 3; ++a) {
+                float4 o = float4::load(org[a] + g),
+                       inv = float4::load(inv_dir[a] + g);
+                float4 t0 = (float4(box._min[a]) - o) * inv,
+                       t1 = (float4(box._max[a]) - o) * inv;
+
+                tnear = max4(tnear, min4(t0, t1));
+                tfar = min4(tfar, max4(t0, t1));
+            }
+
+            hits |= less4(tnear, tfar) << g;
+        }
+
+        return hits & mask;
+    }
+};
+
+inline int lane_count(packet_mask mask)
+{
+    int n = 0;
+    for(; mask; mask &= mask - 1)
+        ++n;
+    return n;
+}
+
+#endif // __PACKET_H__
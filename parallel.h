@@ -0,0 +1,83 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "perf_counters.h"
+
+// Set by set_thread_limit(), 0 for no limit.
+inline int &thread_limit()
+{
+    static int limit = 0;
+    return limit;
+}
+
+inline void set_thread_limit(int n)
+{
+    thread_limit() = n;
+}
+
+// Threads the parallel helpers use: every core, unless limited.
+inline int hardware_threads()
+{
+    if(thread_limit() > 0)
+        return thread_limit();
+
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? int(n) : 1;
+}
+
+// Splits [first, last) in at most 'chunks' contiguous ranges and runs
+// f(chunk, begin, end) for each one on its own thread. The calling thread
+// takes the first chunk. The others count in its perf phase.
+template <typename F>
+void parallel_chunks(int first, int last, int chunks, F f)
+{
+    int n = last - first;
+
+    if(n <= 0)
+        return;
+
+    chunks = std::max(1, std::min(chunks, n));
+
+    if(chunks == 1) {
+        f(0, first, last);
+        return;
+    }
+
+    int size = (n + chunks - 1) / chunks;
+    perf_phase phase = current_perf_phase();
+    std::vector<std::thread> pool;
+
+    for(int c = 1; c < chunks; ++c) {
+        int begin = first + c * size;
+        int end = std::min(last, begin + size);
+
+        if(begin < end) {
+            pool.emplace_back([&f, phase](int c, int begin, int end) {
+                perf_phase_scope scope(phase);
+                f(c, begin, end);
+            }, c, begin, end);
+        }
+    }
+
+    f(0, first, std::min(last, first + size));
+
+    for(auto &t : pool)
+        t.join();
+}
+
+// Runs f(begin, end) over [first, last), one chunk per hardware thread, but
+// never with chunks smaller than 'grain' items.
+template <typename F>
+void parallel_for(int first, int last, int grain, F f)
+{
+    int n = last - first;
+    int chunks = std::min(hardware_threads(), (n + grain - 1) / std::max(grain, 1));
+
+    parallel_chunks(first, last, chunks, [&f](int, int begin, int end) { f(begin, end); });
+}
+
+#endif // __PARALLEL_H__
@@ -0,0 +1,289 @@
+#include "perf_counters.h"
+
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+static const char *counter_names[perf_counter_kinds] = {
+    "cycles", "instructions", "cache misses", "branch misses", "L1D misses", "LLC misses"
+};
+
+perf_counters::perf_counters()
+{
+    for(int k = 0; k < perf_counter_kinds; ++k)
+        fd[k] = -1;
+}
+
+perf_counters::~perf_counters()
+{
+#ifdef __linux__
+    for(int k = 0; k < perf_counter_kinds; ++k) {
+        if( fd[k] >= 0 )
+            close(fd[k]);
+    }
+#endif
+}
+
+#ifdef __linux__
+static int open_counter(uint32_t type, uint64_t config)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+static uint64_t cache_miss(uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+#endif
+
+bool perf_counters::open()
+{
+    bool any = false;
+
+#ifdef __linux__
+    const uint32_t types[perf_counter_kinds] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE
+    };
+    const uint64_t configs[perf_counter_kinds] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+        cache_miss(PERF_COUNT_HW_CACHE_L1D), cache_miss(PERF_COUNT_HW_CACHE_LL)
+    };
+
+    for(int k = 0; k < perf_counter_kinds; ++k) {
+        fd[k] = open_counter(types[k], configs[k]);
+        any = any || fd[k] >= 0;
+    }
+#endif
+
+    return any;
+}
+
+void perf_counters::start()
+{
+#ifdef __linux__
+    for(int k = 0; k < perf_counter_kinds; ++k) {
+        if( fd[k] >= 0 ) {
+            ioctl(fd[k], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd[k], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+perf_sample perf_counters::read() const
+{
+    perf_sample s;
+
+    for(int k = 0; k < perf_counter_kinds; ++k) {
+        s.value[k] = 0;
+        s.valid[k] = false;
+
+#ifdef __linux__
+        uint64_t v[3];      // Value, time enabled, time running.
+
+        if( fd[k] >= 0 && ::read(fd[k], v, sizeof(v)) == sizeof(v) ) {
+            s.valid[k] = true;
+            s.value[k] = v[2] > 0 && v[2] < v[1] ? uint64_t(double(v[0]) * v[1] / v[2]) : v[0];
+        }
+#endif
+    }
+
+    return s;
+}
+
+perf_sample perf_counters::stop()
+{
+    perf_sample s = read();
+
+#ifdef __linux__
+    for(int k = 0; k < perf_counter_kinds; ++k) {
+        if( fd[k] >= 0 )
+            ioctl(fd[k], PERF_EVENT_IOC_DISABLE, 0);
+    }
+#endif
+
+    return s;
+}
+
+std::ostream& operator<<(std::ostream &os, const perf_sample &s)
+{
+    for(int k = 0; k < perf_counter_kinds; ++k) {
+        os << (k > 0 ? ", " : "") << counter_names[k] << " ";
+        if( s.valid[k] )
+            os << s.value[k];
+        else
+            os << "unavailable";
+    }
+
+    return os;
+}
+
+//
+// PHASES
+//
+
+static std::mutex merged_mutex;
+static perf_report merged;
+static std::atomic<bool> warned(false);
+
+static void add(perf_sample &a, const perf_sample &b)
+{
+    for(int k = 0; k < perf_counter_kinds; ++k) {
+        a.value[k] += b.value[k];
+        a.valid[k] = a.valid[k] || b.valid[k];
+    }
+}
+
+// The counters of a thread, opened the first time it enters a phase.
+struct thread_phase_counters
+{
+    perf_counters   counters;
+    bool            opened = false,
+                    ok = false;
+    perf_phase      phase = perf_phase_none;
+    perf_sample     last,
+                    total[perf_phases] = {};
+
+    ~thread_phase_counters()
+    {
+        if( !ok )
+            return;
+
+        std::lock_guard<std::mutex> lock(merged_mutex);
+        for(int p = 0; p < perf_phases; ++p)
+            add(merged.phase[p], total[p]);
+        ++merged.threads;
+    }
+};
+
+static thread_local thread_phase_counters tls_phase;
+
+void enable_phase_counters()
+{
+    phase_counters_enabled() = true;
+}
+
+perf_phase switch_perf_phase(perf_phase phase)
+{
+    thread_phase_counters &t = tls_phase;
+
+    if( !t.opened ) {
+        t.opened = true;
+        t.ok = t.counters.open();
+
+        if( t.ok ) {
+            t.counters.start();
+            t.last = t.counters.read();
+        }
+        else if( !warned.exchange(true) )
+            std::cerr << "Perf: hardware counters unavailable, check /proc/sys/kernel/perf_event_paranoid\n";
+    }
+
+    if( t.ok ) {
+        perf_sample now = t.counters.read();
+
+        if( t.phase != perf_phase_none ) {
+            // Scaled counts can step back a little when the kernel multiplexes.
+            for(int k = 0; k < perf_counter_kinds; ++k) {
+                if( now.value[k] > t.last.value[k] )
+                    t.total[t.phase].value[k] += now.value[k] - t.last.value[k];
+                t.total[t.phase].valid[k] = t.total[t.phase].valid[k] || now.valid[k];
+            }
+        }
+
+        t.last = now;
+    }
+
+    perf_phase previous = t.phase;
+    t.phase = phase;
+
+    return previous;
+}
+
+perf_phase current_perf_phase()
+{
+    return phase_counters_enabled() ? tls_phase.phase : perf_phase_none;
+}
+
+perf_report collect_phase_counters()
+{
+    std::lock_guard<std::mutex> lock(merged_mutex);
+    perf_report r = merged;
+
+    if( tls_phase.ok ) {
+        for(int p = 0; p < perf_phases; ++p)
+            add(r.phase[p], tls_phase.total[p]);
+        ++r.threads;
+    }
+
+    return r;
+}
+
+void print_perf_report(std::ostream &os, const perf_report &r, uint64_t rays)
+{
+    if( r.threads == 0 ) {
+        os << "Perf: unavailable\n";
+        return;
+    }
+
+    const char *phase_names[perf_phases] = { "scene", "bvh", "trace", "shade", "output" };
+
+    os << "Perf: " << r.threads << " threads counted\n" << std::setw(8) << "phase";
+    for(int k = 0; k < perf_counter_kinds; ++k)
+        os << std::setw(16) << counter_names[k];
+    os << std::setw(8) << "IPC\n";
+
+    for(int p = 0; p < perf_phases; ++p) {
+        const perf_sample &s = r.phase[p];
+        os << std::setw(8) << phase_names[p];
+
+        for(int k = 0; k < perf_counter_kinds; ++k) {
+            if( s.valid[k] )
+                os << std::setw(16) << s.value[k];
+            else
+                os << std::setw(16) << "-";
+        }
+
+        if( s.valid[perf_cycles] && s.valid[perf_instructions] && s.value[perf_cycles] > 0 )
+            os << std::setw(8) << std::fixed << std::setprecision(2) << double(s.value[perf_instructions]) / s.value[perf_cycles];
+        os << "\n";
+    }
+
+    if( rays == 0 )
+        return;
+
+    // Tracing and shading together, scalar mode can not tell them apart.
+    perf_sample render = r.phase[perf_phase_trace];
+    add(render, r.phase[perf_phase_shade]);
+
+    const char *separator = "Perf: per ray ";
+
+    for(int k = perf_cache_misses; k < perf_counter_kinds; ++k) {
+        if( render.valid[k] ) {
+            os << separator << std::setprecision(3) << double(render.value[k]) / rays << " " << counter_names[k];
+            separator = ", ";
+        }
+    }
+    if( render.valid[perf_cache_misses] || render.valid[perf_branch_misses] || render.valid[perf_l1d_misses] || render.valid[perf_llc_misses] )
+        os << "\n";
+    os.unsetf(std::ios::fixed);
+}
@@ -0,0 +1,108 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <stdint.h>
+#include <iostream>
+
+enum perf_counter_kind
+{
+    perf_cycles,
+    perf_instructions,
+    perf_cache_misses,  // Whatever the CPU calls its cache misses, usually the last level ones.
+    perf_branch_misses,
+    perf_l1d_misses,    // L1 data cache read misses.
+    perf_llc_misses,    // Last level cache read misses, the L2 or L3 depending on the CPU.
+    perf_counter_kinds
+};
+
+struct perf_sample
+{
+    uint64_t    value[perf_counter_kinds];
+    bool        valid[perf_counter_kinds];  // False for the counters the system would not open.
+};
+
+std::ostream& operator<<(std::ostream &os, const perf_sample &s);
+
+// Hardware counters of the calling thread. Linux only, through
+// perf_event_open. Elsewhere, or when the kernel refuses, every counter is
+// invalid and nothing else changes. Counters the CPU has to share are
+// scaled up to the time they were enabled.
+class perf_counters
+{
+    public:
+        perf_counters();
+        ~perf_counters();
+
+        // Opens the counters, stopped. False when none could be opened.
+        bool open();
+        void start();
+        perf_sample read() const;
+        perf_sample stop();
+
+        int fd[perf_counter_kinds];
+};
+
+//
+// PHASES
+//
+
+enum perf_phase
+{
+    perf_phase_scene,   // Running the scene builder.
+    perf_phase_bvh,     // compile_world and the BVH builds.
+    perf_phase_trace,   // Intersection. In scalar mode the shading too, paths go depth first.
+    perf_phase_shade,   // Wavefront shading queues and compaction.
+    perf_phase_output,  // Writing the images.
+    perf_phases,
+    perf_phase_none = -1
+};
+
+// Counting by phase is off until enabled. Then every thread that enters a
+// phase opens its own counters, and what they count goes to the phase the
+// thread is in. Threads add their counts up when they exit.
+void enable_phase_counters();
+
+inline bool &phase_counters_enabled()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+// Moves the calling thread to phase and returns the one it was in.
+perf_phase switch_perf_phase(perf_phase phase);
+perf_phase current_perf_phase();
+
+// The calling thread is in phase while the scope lasts. Nothing when counting is off.
+class perf_phase_scope
+{
+    public:
+        explicit perf_phase_scope(perf_phase phase) : active(phase_counters_enabled()), previous(perf_phase_none)
+        {
+            if( active )
+                previous = switch_perf_phase(phase);
+        }
+
+        ~perf_phase_scope()
+        {
+            if( active )
+                switch_perf_phase(previous);
+        }
+
+    private:
+        bool        active;
+        perf_phase  previous;
+};
+
+struct perf_report
+{
+    perf_sample phase[perf_phases];
+    int         threads;            // Threads whose counters opened.
+};
+
+// The counts of the threads that exited and of the calling one.
+perf_report collect_phase_counters();
+
+// A line per phase with IPC, and the misses per ray of tracing and shading.
+void print_perf_report(std::ostream &os, const perf_report &r, uint64_t rays);
+
+#endif // __PERF_COUNTERS_H__
@@ -1,8 +1,10 @@
 #include "perlin.h"
+#include "memory_stats.h"
 
 static vec3 *perlin_generate()
 {
     vec3 *p = new vec3[256];
+    account_memory(memory_perlin, 256 * sizeof(vec3), 1);
     
     for(int i = 0; i < 256; ++i)
         p[i] = unit_vector(vec3(-1.0 + 2.0*drand48(), -1.0 + 2.0*drand48(), -1.0 + 2.0*drand48()));
@@ -23,6 +25,7 @@ static void permute(int *p, int n)
 static int *perlin_generate_perm()
 {
     int *p = new int[256];
+    account_memory(memory_perlin, 256 * sizeof(int), 1);
     
     for(int i = 0; i < 256; ++i)
         p[i] = i;
@@ -1,12 +1,30 @@
 #include "rangen.h"
 
+#include <atomic>
 #include <random>
 
 static std::random_device rd;  //Will be used to obtain a seed for the random number engine
-static std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-static std::uniform_real_distribution<> dis(0.0, 1.0);
+static unsigned int base_seed = rd();
+static std::atomic<unsigned int> streams(0);
+
+// One engine per thread, sharing one between tracing threads is a data race.
+// The first thread to ask gets base_seed itself, the others offsets of it.
+static std::mt19937 &engine()
+{
+    static thread_local std::mt19937 gen(base_seed + 0x9e3779b9u * streams++);
+    return gen;
+}
 
 float drand48()
 {
-    return dis(gen);
+    std::uniform_real_distribution<> dis(0.0, 1.0);
+    return dis(engine());
+}
+
+// Reseeds the calling thread, threads started later derive their seeds from it.
+void seed_drand48(unsigned int seed)
+{
+    base_seed = seed;
+    streams = 1;
+    engine().seed(seed);
 }
@@ -2,5 +2,6 @@
 #define __RANGEN_H__
 
 float drand48();
+void seed_drand48(unsigned int seed);
 
 #endif // __RANGEN_H__
\ No newline at end of file
@@ -0,0 +1,737 @@
+#include "render.h"
+#include "bdpt.h"
+#include "materials.h"
+#include "parallel.h"
+#include "stats.h"
+#include "morton.h"
+#include "timeline.h"
+
+#include <float.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+render_options default_render_options()
+{
+    render_options options;
+    options.mode = render_scalar;
+    options.threads = 0;
+    options.tile_size = 16;
+    options.packet_size = 16;
+    options.pool_size = 1 << 16;
+    options.sort_batch = 0;
+    options.heatmap = heatmap_none;
+    options.integrator = integrator_path;
+    options.light_sampler = light_sampler_uniform;
+
+    return options;
+}
+
+// Rays traced by the calling thread, the renderer adds them up when its threads finish.
+static thread_local uint64_t traced_rays;
+
+// Radiance along r when it misses the world.
+static vec3 background(const ray &r, const scene &the_scene)
+{
+    return the_scene.environment ? the_scene.environment->radiance(r.direction()) : vec3(0.0, 0.0, 0.0);
+}
+
+// Radiance leaving the hit point of r toward its origin.
+static vec3 shade(const ray &r, const hit_record &rec, const scene &the_scene, int depth)
+{
+    ray scattered;
+    vec3 attenuation;
+    vec3 emmited = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+
+    if ( depth < kMaxDepth && (RT_STAT(scatter_calls[rec.mat_ptr->kind]), rec.mat_ptr->scatter(r, rec, attenuation, scattered)) ) {
+        return emmited + attenuation * color(scattered, the_scene, depth+1);
+
+    }
+    else {
+        RT_STAT_PATH(depth + 1, depth < kMaxDepth ? stat_end_absorbed : stat_end_max_depth);
+        return emmited;
+    }
+}
+
+vec3 color(const ray &r, const scene &the_scene, int depth)
+{
+    hit_record rec;
+    ++traced_rays;
+    RT_STAT(rays[depth == 0 ? stat_ray_camera : stat_ray_scatter]);
+    if(the_scene.world->hit(r, 0.001, FLT_MAX, rec)) {
+        return shade(r, rec, the_scene, depth);
+    }
+    else {
+        RT_STAT_PATH(depth + 1, stat_end_miss);
+        return background(r, the_scene);
+    }
+}
+
+//
+// MIS
+//
+
+// Written with the ratio of the pdfs, their squares overflow at grazing angles on lights.
+static float power_heuristic(float pdf, float other_pdf)
+{
+    if( pdf >= other_pdf ) {
+        float r = other_pdf / pdf;
+        return 1.0 / (1.0 + r * r);
+    }
+
+    float r = pdf / other_pdf;
+    return r * r / (1.0 + r * r);
+}
+
+// Of a light sample going to the environment rather than to the lights.
+static float environment_probability(const scene &the_scene)
+{
+    if( !the_scene.environment )
+        return 0.0;
+
+    return the_scene.lights ? 0.5 : 1.0;
+}
+
+// A path of the MIS integrator between bounces. The bounce is split in
+// three steps so the renderer can trace the shadow rays of many paths at
+// once between the first two.
+struct mis_path
+{
+    ray         r;
+    hit_record  rec;            // Where r hit.
+    vec3        radiance,
+                throughput;
+    float       bsdf_pdf;       // Of the direction of r, 0 for camera rays and after delta bounces.
+    int         depth;
+    bsdf_sample s;              // The bounce off rec, once mis_scatter() picked it.
+
+    mis_path() {}
+    mis_path(const ray &r_in, const hit_record &hit) : r(r_in), rec(hit), radiance(0.0, 0.0, 0.0), throughput(1.0, 1.0, 1.0), bsdf_pdf(0.0), depth(0) {}
+};
+
+// What the hit point emits, then the BSDF sample. Emitters found by BSDF
+// rays are weighted against the light sample that could have found them
+// too, except after a mirror or glass bounce. False when the path ends.
+static bool mis_scatter(mis_path &path, const scene &the_scene, float environment_chance)
+{
+    vec3 emitted = path.rec.mat_ptr->emitted(path.rec.u, path.rec.v, path.rec.p);
+
+    if( path.bsdf_pdf > 0.0 && the_scene.lights && (emitted.x() > 0.0 || emitted.y() > 0.0 || emitted.z() > 0.0) )
+        emitted *= power_heuristic(path.bsdf_pdf, (1.0f - environment_chance) * the_scene.lights->pdf_value(path.r.origin(), path.r.direction()));
+    path.radiance += path.throughput * emitted;
+
+    if( path.depth >= kMaxDepth || !(RT_STAT(scatter_calls[path.rec.mat_ptr->kind]), path.rec.mat_ptr->sample(path.r, path.rec, path.s)) ) {
+        RT_STAT_PATH(path.depth + 1, path.depth < kMaxDepth ? stat_end_absorbed : stat_end_max_depth);
+        return false;
+    }
+
+    return true;
+}
+
+// Light sample, of the environment or of the lights. False when there is
+// no shadow ray to trace, otherwise the ray, how far it has to be clear and
+// what the sample adds when it is. The shadow ray to a light stops short of
+// the point on it.
+static bool mis_light_sample(const mis_path &path, const scene &the_scene, float environment_chance,
+                             ray &shadow, float &tmax, vec3 &contribution)
+{
+    const ray &r = path.r;
+    const hit_record &rec = path.rec;
+
+    if( path.s.pdf > 0.0 && environment_chance > 0.0 && drand48() < environment_chance ) {
+        vec3 to_sky = the_scene.environment->random();
+        float sky_pdf = environment_chance * the_scene.environment->pdf_value(to_sky);
+        vec3 f = rec.mat_ptr->eval(r, rec, to_sky);
+
+        if( sky_pdf <= 0.0 || (f.x() <= 0.0 && f.y() <= 0.0 && f.z() <= 0.0) )
+            return false;
+
+        float weight = power_heuristic(sky_pdf, rec.mat_ptr->pdf(r, rec, to_sky));
+        shadow = ray(rec.p, to_sky, r.time());
+        tmax = FLT_MAX;
+        contribution = path.throughput * f * the_scene.environment->radiance(to_sky) * (weight / sky_pdf);
+
+        return true;
+    }
+    else if( path.s.pdf > 0.0 && the_scene.lights ) {
+        vec3 to_light = unit_vector(the_scene.lights->random(rec.p));
+        float light_pdf = (1.0f - environment_chance) * the_scene.lights->pdf_value(rec.p, to_light);
+        vec3 f = rec.mat_ptr->eval(r, rec, to_light);
+        hit_record light_rec;
+
+        if( light_pdf <= 0.0 || (f.x() <= 0.0 && f.y() <= 0.0 && f.z() <= 0.0) )
+            return false;
+
+        shadow = ray(rec.p, to_light, r.time());
+        if( !the_scene.lights->hit(shadow, 0.001, FLT_MAX, light_rec) )
+            return false;
+
+        float weight = power_heuristic(light_pdf, rec.mat_ptr->pdf(r, rec, to_light));
+        tmax = light_rec.t - 0.001;
+        contribution = path.throughput * f * light_rec.mat_ptr->emitted(light_rec.u, light_rec.v, light_rec.p) * (weight / light_pdf);
+
+        return true;
+    }
+
+    return false;
+}
+
+// Follows the BSDF sample to the next hit. The environment found by it is
+// weighted against the environment sample. False when the path leaves.
+static bool mis_continue(mis_path &path, const scene &the_scene, float environment_chance)
+{
+    path.bsdf_pdf = path.s.pdf;
+    path.throughput *= path.s.weight();
+    path.r = ray(path.rec.p, path.s.direction, path.r.time());
+
+    ++traced_rays;
+    RT_STAT(rays[stat_ray_scatter]);
+    if( !the_scene.world->hit(path.r, 0.001, FLT_MAX, path.rec) ) {
+        RT_STAT_PATH(path.depth + 2, stat_end_miss);
+
+        if( the_scene.environment ) {
+            vec3 sky = the_scene.environment->radiance(path.r.direction());
+            if( path.bsdf_pdf > 0.0 )
+                sky *= power_heuristic(path.bsdf_pdf, environment_chance * the_scene.environment->pdf_value(path.r.direction()));
+            path.radiance += path.throughput * sky;
+        }
+        return false;
+    }
+
+    ++path.depth;
+    return true;
+}
+
+// The rest of the path, a bounce at a time with one shadow ray each.
+static void trace_mis(mis_path &path, const scene &the_scene, float environment_chance)
+{
+    while( mis_scatter(path, the_scene, environment_chance) ) {
+        ray shadow;
+        float tmax;
+        vec3 contribution;
+
+        if( mis_light_sample(path, the_scene, environment_chance, shadow, tmax, contribution) ) {
+            ++traced_rays;
+            RT_STAT(rays[stat_ray_shadow]);
+            if( !the_scene.world->occluded(shadow, 0.001, tmax) )
+                path.radiance += contribution;
+        }
+
+        if( !mis_continue(path, the_scene, environment_chance) )
+            break;
+    }
+}
+
+// Radiance leaving the hit point of r toward its origin, a path at a time.
+static vec3 shade_mis(const ray &r, const hit_record &rec, const scene &the_scene)
+{
+    mis_path path(r, rec);
+
+    trace_mis(path, the_scene, environment_probability(the_scene));
+
+    return path.radiance;
+}
+
+vec3 color_mis(const ray &r, const scene &the_scene)
+{
+    hit_record rec;
+    ++traced_rays;
+    RT_STAT(rays[stat_ray_camera]);
+    if( the_scene.world->hit(r, 0.001, FLT_MAX, rec) )
+        return shade_mis(r, rec, the_scene);
+
+    RT_STAT_PATH(1, stat_end_miss);
+    return background(r, the_scene);
+}
+
+static std::mutex progress_mutex;
+
+static void progress(const char *what, long long done, long long total)
+{
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    std::cout << "\rRenderizando " << what << " " << done << "/" << total << std::flush;
+}
+
+static ray camera_ray(scene &the_scene, int i, int j)
+{
+    float u = float(i + drand48()) / float(the_scene.nx);
+    float v = float(j + drand48()) / float(the_scene.ny);
+
+    return the_scene.cam->get_ray(u, v);
+}
+
+//
+// SCALAR
+//
+
+// Running total of what the heatmap measures, for the calling thread.
+static uint64_t heat_counter(heatmap_kind kind)
+{
+    switch( kind ) {
+#ifdef RT_STATS
+        case heatmap_nodes:
+            return thread_stats().bvh_nodes;
+        case heatmap_tests:
+            return thread_stats().prim_tests;
+#endif
+        case heatmap_time:
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        default:
+            return 0;
+    }
+}
+
+// The MIS paths of a block from the camera hits in mask. The shadow rays of
+// their first light samples start close together and head for the same
+// lights, they are traced as one packet. The paths go on one at a time.
+static void shade_block_mis(const scene &the_scene, const ray_packet &camera, packet_mask mask, const hit_record *recs, int count, vec3 *col)
+{
+    float environment_chance = environment_probability(the_scene);
+    mis_path paths[kPacketSize];
+    bool alive[kPacketSize];
+    vec3 contribution[kPacketSize];
+    int lane_path[kPacketSize];
+    ray_packet shadows;
+    int shadow_count = 0;
+
+    shadows.tmin = 0.001;
+
+    for(int k = 0; k < count; ++k) {
+        if( !(mask >> k & 1) )
+            continue;
+
+        paths[k] = mis_path(camera.get(k), recs[k]);
+        alive[k] = mis_scatter(paths[k], the_scene, environment_chance);
+
+        ray shadow;
+        float tmax;
+
+        if( alive[k] && mis_light_sample(paths[k], the_scene, environment_chance, shadow, tmax, contribution[shadow_count]) ) {
+            lane_path[shadow_count] = k;
+            shadows.set(shadow_count++, shadow, tmax);
+        }
+    }
+
+    if( shadow_count > 0 ) {
+        shadows.finish(shadow_count);
+        traced_rays += shadow_count;
+        RT_STAT_ADD(rays[stat_ray_shadow], shadow_count);
+
+        packet_mask blocked = the_scene.world->occluded_packet(shadows, (1u << shadow_count) - 1);
+
+        for(int i = 0; i < shadow_count; ++i) {
+            if( !(blocked >> i & 1) )
+                paths[lane_path[i]].radiance += contribution[i];
+        }
+    }
+
+    for(int k = 0; k < count; ++k) {
+        if( !(mask >> k & 1) )
+            continue;
+
+        if( alive[k] && mis_continue(paths[k], the_scene, environment_chance) )
+            trace_mis(paths[k], the_scene, environment_chance);
+        col[k] += paths[k].radiance;
+    }
+}
+
+// Camera rays of a block of pixels, one sample each, traced as a packet. The
+// paths go on one at a time from their first hit.
+static void trace_block(scene &the_scene, integrator_kind integrator, int x0, int y0, int w, int h, vec3 *col)
+{
+    ray_packet p;
+    hit_record recs[kPacketSize];
+    int count = 0;
+
+    p.tmin = 0.001;
+    for(int j = y0; j < y0 + h; ++j) {
+        for(int i = x0; i < x0 + w; ++i)
+            p.set(count++, camera_ray(the_scene, i, j), FLT_MAX);
+    }
+    p.finish(count);
+    traced_rays += count;
+
+    packet_mask hits = the_scene.world->hit_packet(p, (1u << count) - 1, recs);
+
+    for(int k = 0; k < count; ++k) {
+        RT_STAT(rays[stat_ray_camera]);
+        if( !(hits >> k & 1) ) {
+            RT_STAT_PATH(1, stat_end_miss);
+            col[k] += background(p.get(k), the_scene);
+        }
+        else if( integrator != integrator_mis )
+            col[k] += shade(p.get(k), recs[k], the_scene, 0);
+    }
+
+    if( integrator == integrator_mis && hits )
+        shade_block_mis(the_scene, p, hits, recs, count, col);
+}
+
+static uint64_t trace_tiles(scene &the_scene, const render_options &options, vec3 *image, const render_aov *aov)
+{
+    float *heat = aov && options.heatmap != heatmap_none ? aov->heat : nullptr;
+    std::vector<tile_record> *records = aov ? aov->tiles : nullptr;
+    std::mutex records_mutex;
+    auto render_start = std::chrono::steady_clock::now();
+
+    // Light tracing splats land anywhere in the image, they are added once every tile is done.
+    std::unique_ptr<bdpt_context> bdpt(options.integrator == integrator_bdpt ? new bdpt_context(the_scene) : nullptr);
+
+    int tile = options.tile_size;
+    int block_w = options.packet_size >= 4 && !bdpt ? (options.packet_size >= 8 ? 4 : 2) : 1,
+        block_h = options.packet_size >= 4 ? options.packet_size / block_w : 1;
+    int tiles_x = (the_scene.nx + tile - 1) / tile;
+    int tiles_y = (the_scene.ny + tile - 1) / tile;
+    int tiles = tiles_x * tiles_y;
+    std::atomic<int> next(0), done(0);
+    std::atomic<uint64_t> rays(0);
+
+    // Tiles are handed out one at a time, so threads stuck on expensive ones do not hold up the rest.
+    auto worker = [&](int thread) {
+        perf_phase_scope tracing(perf_phase_trace);
+        name_timeline_thread(thread ? "render" : "main");
+        traced_rays = 0;
+
+        for(int t = next++; t < tiles; t = next++) {
+            int x0 = (t % tiles_x) * tile,
+                y0 = (t / tiles_x) * tile;
+
+            int x1 = std::min(x0 + tile, the_scene.nx),
+                y1 = std::min(y0 + tile, the_scene.ny);
+
+            double tile_start = std::chrono::duration<double>(std::chrono::steady_clock::now() - render_start).count();
+            timeline_scope span("tile", "render");
+            span.arg("x0", x0);
+            span.arg("y0", y0);
+
+            if( block_w == 1 ) {
+                for(int j = y0; j < y1; ++j) {
+                    for(int i = x0; i < x1; ++i) {
+                        vec3 col(0.0, 0.0, 0.0);
+                        uint64_t cost = heat ? heat_counter(options.heatmap) : 0;
+
+                        for(int s = 0; s < the_scene.ns; ++s) {
+                            ray r = camera_ray(the_scene, i, j);
+
+                            if( bdpt )
+                                col += color_bdpt(r, *bdpt, traced_rays);
+                            else
+                                col += options.integrator == integrator_mis ? color_mis(r, the_scene) : color(r, the_scene, 0);
+                        }
+
+                        image[j * the_scene.nx + i] = col / float(the_scene.ns);
+                        if( heat )
+                            heat[j * the_scene.nx + i] = float(heat_counter(options.heatmap) - cost);
+                    }
+                }
+            }
+            else {
+                for(int by = y0; by < y1; by += block_h) {
+                    for(int bx = x0; bx < x1; bx += block_w) {
+                        int w = std::min(block_w, x1 - bx),
+                            h = std::min(block_h, y1 - by);
+                        vec3 col[kPacketSize];
+
+                        for(int k = 0; k < w * h; ++k)
+                            col[k] = vec3(0.0, 0.0, 0.0);
+
+                        uint64_t cost = heat ? heat_counter(options.heatmap) : 0;
+
+                        for(int s = 0; s < the_scene.ns; ++s)
+                            trace_block(the_scene, options.integrator, bx, by, w, h, col);
+
+                        float share = heat ? float(heat_counter(options.heatmap) - cost) / float(w * h) : 0.0f;
+
+                        for(int k = 0; k < w * h; ++k) {
+                            image[(by + k / w) * the_scene.nx + bx + k % w] = col[k] / float(the_scene.ns);
+                            if( heat )
+                                heat[(by + k / w) * the_scene.nx + bx + k % w] = share;
+                        }
+                    }
+                }
+            }
+
+            if( records ) {
+                double tile_end = std::chrono::duration<double>(std::chrono::steady_clock::now() - render_start).count();
+                std::lock_guard<std::mutex> lock(records_mutex);
+                records->push_back({ x0, y0, x1, y1, thread, tile_start, tile_end });
+            }
+
+            progress("tile", ++done, tiles);
+        }
+
+        rays += traced_rays;
+    };
+
+    std::vector<std::thread> pool;
+    for(int t = 1; t < hardware_threads(); ++t)
+        pool.emplace_back(worker, t);
+
+    worker(0);
+
+    for(auto &t : pool)
+        t.join();
+
+    if( bdpt ) {
+        for(int i = 0; i < the_scene.nx * the_scene.ny; ++i)
+            image[i] += bdpt->splats.get(i) / float(the_scene.ns);
+    }
+
+    return rays;
+}
+
+//
+// WAVEFRONT
+//
+
+struct wavefront_path
+{
+    ray     r;
+    vec3    throughput,
+            radiance;
+    int     pixel,
+            depth;
+    bool    active;
+};
+
+const int kWavefrontGrain = 256;    // Paths per task in the parallel stages.
+
+// Shading stage for one material queue. The qualified calls are not virtual,
+// and the inline ones get inlined into the loop.
+template <typename M>
+static void shade(std::vector<wavefront_path> &paths, const std::vector<hit_record> &recs, const std::vector<int> &queue)
+{
+    parallel_for(0, int(queue.size()), kWavefrontGrain, [&](int begin, int end) {
+        for(int q = begin; q < end; ++q) {
+            wavefront_path &path = paths[queue[q]];
+            const hit_record &rec = recs[queue[q]];
+            const M *mat = static_cast<const M *>(rec.mat_ptr);
+            bsdf_sample s;
+
+            path.radiance += path.throughput * mat->M::emitted(rec.u, rec.v, rec.p);
+
+            if( path.depth < kMaxDepth && (RT_STAT(scatter_calls[mat->kind]), mat->M::sample(path.r, rec, s)) ) {
+                path.throughput *= s.weight();
+                path.r = ray(rec.p, s.direction, path.r.time());
+                ++path.depth;
+            }
+            else {
+                RT_STAT_PATH(path.depth + 1, path.depth < kMaxDepth ? stat_end_absorbed : stat_end_max_depth);
+                path.active = false;
+            }
+        }
+    });
+}
+
+// Materials the renderer does not know, through their virtual functions.
+static void shade_other(std::vector<wavefront_path> &paths, const std::vector<hit_record> &recs, const std::vector<int> &queue)
+{
+    parallel_for(0, int(queue.size()), kWavefrontGrain, [&](int begin, int end) {
+        for(int q = begin; q < end; ++q) {
+            wavefront_path &path = paths[queue[q]];
+            const hit_record &rec = recs[queue[q]];
+            bsdf_sample s;
+
+            path.radiance += path.throughput * rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+
+            if( path.depth < kMaxDepth && (RT_STAT(scatter_calls[rec.mat_ptr->kind]), rec.mat_ptr->sample(path.r, rec, s)) ) {
+                path.throughput *= s.weight();
+                path.r = ray(rec.p, s.direction, path.r.time());
+                ++path.depth;
+            }
+            else {
+                RT_STAT_PATH(path.depth + 1, path.depth < kMaxDepth ? stat_end_absorbed : stat_end_max_depth);
+                path.active = false;
+            }
+        }
+    });
+}
+
+const int kRayKeyBits = 30;
+
+// Sort key of a bounced ray: the octant of its direction, then the Morton
+// code of its origin within the batch bounds, then a coarse one of its
+// direction.
+static uint64_t ray_key(const ray &r, const vec3 &lo, const vec3 &extent)
+{
+    vec3 d = unit_vector(r.direction());
+    vec3 o = r.origin() - lo;
+    uint64_t octant = (d.x() < 0.0f) | (d.y() < 0.0f) << 1 | (d.z() < 0.0f) << 2;
+
+    for(int a = 0; a < 3; ++a)
+        o[a] = extent[a] > 0.0f ? o[a] / extent[a] : 0.5f;
+
+    // 7 bits per axis for the origin, 2 for the direction.
+    return octant << 27 | (morton_code(o, 30) >> 9) << 6 | morton_code(0.5f * d + vec3(0.5, 0.5, 0.5), 30) >> 24;
+}
+
+// Reorders the first count paths, batch by batch, so that rays next to each
+// other in the pool start close together and go the same way. Intersection
+// then walks the same BVH nodes for consecutive rays.
+static void sort_paths(std::vector<wavefront_path> &paths, std::vector<wavefront_path> &scratch, int count, int batch)
+{
+    int batches = (count + batch - 1) / batch;
+    scratch.resize(paths.size());
+
+    parallel_for(0, batches, 1, [&](int first, int last) {
+        std::vector<uint64_t> keys;
+        std::vector<int> order;
+
+        for(int b = first; b < last; ++b) {
+            int begin = b * batch,
+                end = std::min(count, begin + batch);
+            aabb bounds = empty_box();
+
+            for(int p = begin; p < end; ++p)
+                bounds = surrounding(bounds, paths[p].r.origin());
+
+            keys.resize(end - begin);
+            order.resize(end - begin);
+            for(int p = begin; p < end; ++p) {
+                keys[p - begin] = ray_key(paths[p].r, bounds.min(), bounds.max() - bounds.min());
+                order[p - begin] = p;
+            }
+
+            radix_sort(keys, order, kRayKeyBits, 1);
+
+            for(int p = begin; p < end; ++p)
+                scratch[p] = paths[order[p - begin]];
+        }
+    });
+
+    std::copy(paths.begin() + count, paths.end(), scratch.begin() + count);
+    paths.swap(scratch);
+}
+
+// Same estimator as color(), reorganized: every stage is one loop over the
+// whole pool doing a single kind of work.
+static uint64_t trace_wavefront(scene &the_scene, const render_options &options, vec3 *image)
+{
+    long long total = (long long)the_scene.nx * the_scene.ny * the_scene.ns,
+              next = 0;
+    uint64_t rays = 0;
+    int pool_size = options.pool_size;
+
+    std::vector<wavefront_path> paths, sorted;
+    std::vector<hit_record> recs(pool_size);
+    std::vector<int> queues[material_kinds];
+
+    paths.reserve(pool_size);
+    sorted.reserve(pool_size);
+    for(auto &q : queues)
+        q.reserve(pool_size);
+
+    long long scratch = (long long)pool_size * (2 * sizeof(wavefront_path) + sizeof(hit_record) + material_kinds * sizeof(int));
+    account_memory(memory_scratch, scratch, 1);
+
+    for(int i = 0; i < the_scene.nx * the_scene.ny; ++i)
+        image[i] = vec3(0.0, 0.0, 0.0);
+
+    while(true) {
+        perf_phase_scope tracing(perf_phase_trace);
+        timeline_scope span("bounce", "render");
+
+        // Sort: the pool only holds bounced rays here, new camera rays are coherent already.
+        if( options.sort_batch > 0 && !paths.empty() )
+            sort_paths(paths, sorted, int(paths.size()), options.sort_batch);
+
+        // Generate: top the pool up with camera paths, a pixel's samples one after another.
+        int first = int(paths.size());
+        int count = int(std::min<long long>(pool_size - first, total - next));
+        long long sample = next;
+
+        paths.resize(first + count);
+        next += count;
+
+        parallel_for(first, first + count, kWavefrontGrain, [&](int begin, int end) {
+            for(int p = begin; p < end; ++p) {
+                wavefront_path &path = paths[p];
+                path.pixel = int((sample + p - first) / the_scene.ns);
+                path.r = camera_ray(the_scene, path.pixel % the_scene.nx, path.pixel / the_scene.nx);
+                path.throughput = vec3(1.0, 1.0, 1.0);
+                path.radiance = vec3(0.0, 0.0, 0.0);
+                path.depth = 0;
+                path.active = true;
+            }
+        });
+
+        if( paths.empty() )
+            break;
+
+        int n = int(paths.size());
+        rays += n;
+
+        // Extend: intersect the whole pool.
+        parallel_for(0, n, kWavefrontGrain, [&](int begin, int end) {
+            for(int p = begin; p < end; ++p) {
+                RT_STAT(rays[paths[p].depth == 0 ? stat_ray_camera : stat_ray_scatter]);
+                if( !the_scene.world->hit(paths[p].r, 0.001, FLT_MAX, recs[p]) ) {
+                    RT_STAT_PATH(paths[p].depth + 1, stat_end_miss);
+                    paths[p].radiance += paths[p].throughput * background(paths[p].r, the_scene);
+                    paths[p].active = false;
+                }
+            }
+        });
+
+        // Queue the hits by material.
+        perf_phase_scope shading(perf_phase_shade);
+        timeline_scope shading_span("shade", "render");
+        shading_span.arg("paths", n);
+
+        for(auto &q : queues)
+            q.clear();
+
+        for(int p = 0; p < n; ++p) {
+            if( paths[p].active )
+                queues[recs[p].mat_ptr->kind].push_back(p);
+        }
+
+        // Shade, one material at a time.
+        shade<lambertian>(paths, recs, queues[material_lambertian]);
+        shade<metal>(paths, recs, queues[material_metal]);
+        shade<dielectric>(paths, recs, queues[material_dielectric]);
+        shade<isotropic>(paths, recs, queues[material_isotropic]);
+        shade<diffuse_light>(paths, recs, queues[material_diffuse_light]);
+        shade_other(paths, recs, queues[material_other]);
+
+        // Compact: finished paths go to their pixel, live ones to the front of the pool.
+        int live = 0;
+
+        for(int p = 0; p < n; ++p) {
+            if( paths[p].active )
+                paths[live++] = paths[p];
+            else
+                image[paths[p].pixel] += paths[p].radiance;
+        }
+
+        paths.resize(live);
+        progress("muestra", next - live, total);
+    }
+
+    for(int i = 0; i < the_scene.nx * the_scene.ny; ++i)
+        image[i] /= float(the_scene.ns);
+
+    account_memory(memory_scratch, -scratch, -1);
+
+    return rays;
+}
+
+uint64_t render(scene &the_scene, const render_options &options, vec3 *image, const render_aov *aov)
+{
+    set_thread_limit(options.threads);
+
+    uint64_t rays;
+    if( options.mode == render_wavefront )
+        rays = trace_wavefront(the_scene, options, image);
+    else
+        rays = trace_tiles(the_scene, options, image, aov);
+
+    std::cout << "\n";
+
+    return rays;
+}
@@ -0,0 +1,76 @@
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include "scene.h"
+#include "light_tree.h"
+
+#include <stdint.h>
+#include <vector>
+
+const int kMaxDepth = 50;
+
+enum render_mode
+{
+    render_scalar,      // A path at a time, depth first, threads taking image tiles.
+    render_wavefront    // A pool of paths advanced one bounce at a time, shaded by material.
+};
+
+enum integrator_kind
+{
+    integrator_path,    // BSDF sampling only, lights are found by chance.
+    integrator_mis,     // Scalar mode. Light sampling too, both weighted with the power heuristic.
+    integrator_bdpt     // Scalar mode, a ray at a time. Camera and light paths joined at every vertex.
+};
+
+// What the heatmap image holds for every pixel, summed over its samples.
+enum heatmap_kind
+{
+    heatmap_none,
+    heatmap_nodes,      // BVH nodes visited, needs -DRT_STATS.
+    heatmap_tests,      // Primitive intersection tests, needs -DRT_STATS.
+    heatmap_time        // Nanoseconds of wall clock time.
+};
+
+struct render_options
+{
+    render_mode mode;
+    int threads,        // 0 for every core.
+        tile_size,      // Scalar mode, pixels on a side.
+        packet_size,    // Scalar mode, camera rays traced together: 4, 8 or 16, 0 for one at a time.
+        pool_size,      // Wavefront mode, paths in flight.
+        sort_batch;     // Wavefront mode, bounced rays are sorted for coherence in batches this big, 0 to not sort.
+    heatmap_kind heatmap;   // Scalar mode. With packets a block of pixels shares its cost evenly.
+    integrator_kind integrator;
+    light_sampler_kind light_sampler;   // MIS integrator, see make_light_sampler().
+};
+
+// A scalar mode tile, when and by which thread it was rendered.
+struct tile_record
+{
+    int     x0, y0, x1, y1,
+            thread;
+    double  start, end;     // Seconds since the render started.
+};
+
+// Optional outputs next to the image, nullptr for the ones not wanted.
+struct render_aov
+{
+    float                       *heat;      // nx*ny values laid out like the image.
+    std::vector<tile_record>    *tiles;
+};
+
+render_options default_render_options();
+
+// Radiance along r, the scalar integrator.
+vec3 color(const ray &r, const scene &the_scene, int depth);
+
+// Radiance along r, one light sample and one BSDF sample at every bounce
+// combined with multiple importance sampling. The environment is sampled as
+// one more light. Without lights the same as color().
+vec3 color_mis(const ray &r, const scene &the_scene);
+
+// Mean of the scene's ns samples for every pixel, linear, nx*ny values with
+// the bottom row first. Returns the rays traced, camera and scattered ones.
+uint64_t render(scene &the_scene, const render_options &options, vec3 *image, const render_aov *aov = nullptr);
+
+#endif // __RENDER_H__
@@ -0,0 +1,357 @@
+#include "bvh_build.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <thread>
+
+//
+// SPATIAL SPLIT BVH
+//
+
+// Part of a reference inside a slab: what the primitive has there, within
+// the box the reference already had.
+bvh_prim_ref bvh_builder::clip(const bvh_prim_ref &r, int axis, float lo, float hi) const
+{
+    bvh_prim_ref c = r;
+    aabb slab;
+
+    if( !list[r.index]->slab_bounding_box(time0, time1, axis, lo, hi, slab) )
+        slab = r.box;
+
+    for(int a = 0; a < 3; ++a) {
+        c.box._min[a] = ffmax(r.box._min[a], slab._min[a]);
+        c.box._max[a] = ffmin(r.box._max[a], slab._max[a]);
+    }
+    c.box._min[axis] = ffmax(c.box._min[axis], lo);
+    c.box._max[axis] = ffmin(c.box._max[axis], hi);
+    c.centroid = 0.5 * (c.box.min() + c.box.max());
+
+    return c;
+}
+
+struct sbvh_spatial_bin
+{
+    aabb    box;
+    int     entries,    // References starting in the bin.
+            exits;      // References ending in it.
+};
+
+struct sbvh_split
+{
+    float   cost;       // Sum of area times count of both sides.
+    int     axis,
+            bin;        // Last bin of the left side, -1 when there is no split.
+    aabb    left,
+            right;
+    int     left_count,
+            right_count;
+};
+
+static void object_split(const std::vector<bvh_prim_ref> &work, const aabb &cbox, sbvh_split &best)
+{
+    int n = int(work.size());
+    int nbins = bin_count(n);
+    vec3 extent = cbox.max() - cbox.min();
+    bvh_range_info *info = new bvh_range_info;
+
+    range_bins(work.data(), 0, n, cbox, nbins, info->bins);
+    best.cost = FLT_MAX;
+    best.bin = -1;
+
+    for(int a = 0; a < 3; ++a) {
+        if(extent[a] <= 0.0)
+            continue;
+
+        aabb right_box[kBins];
+        int right_count[kBins];
+        aabb acc = empty_box();
+        int count = 0;
+
+        for(int b = nbins - 1; b > 0; --b) {
+            grow(acc, info->bins[a][b].box);
+            count += info->bins[a][b].count;
+            right_box[b] = acc;
+            right_count[b] = count;
+        }
+
+        acc = empty_box();
+        count = 0;
+
+        for(int b = 0; b < nbins - 1; ++b) {
+            grow(acc, info->bins[a][b].box);
+            count += info->bins[a][b].count;
+
+            if(count == 0 || count == n)
+                continue;
+
+            float cost = count * acc.surface_area() + right_count[b + 1] * right_box[b + 1].surface_area();
+
+            if(cost < best.cost) {
+                best.cost = cost;
+                best.axis = a;
+                best.bin = b;
+                best.left = acc;
+                best.right = right_box[b + 1];
+                best.left_count = count;
+                best.right_count = right_count[b + 1];
+            }
+        }
+    }
+
+    delete info;
+}
+
+// Bins are fixed slabs of the node box. Every reference is clipped into each
+// bin it crosses, and counted where it enters and where it exits.
+void bvh_builder::spatial_split(const std::vector<bvh_prim_ref> &work, const aabb &box, sbvh_split &best) const
+{
+    best.cost = FLT_MAX;
+    best.bin = -1;
+
+    for(int a = 0; a < 3; ++a) {
+        float lo = box.min()[a];
+        float extent = box.max()[a] - lo;
+
+        if(extent <= 0.0)
+            continue;
+
+        float width = extent / kBins;
+        sbvh_spatial_bin bins[kBins];
+
+        for(int b = 0; b < kBins; ++b) {
+            bins[b].box = empty_box();
+            bins[b].entries = bins[b].exits = 0;
+        }
+
+        for(const bvh_prim_ref &r : work) {
+            int first = bin_index(r.box.min()[a], lo, extent, kBins);
+            int last = bin_index(r.box.max()[a], lo, extent, kBins);
+
+            for(int b = first; b <= last; ++b) {
+                float b_lo = b == first ? -FLT_MAX : lo + b * width;
+                float b_hi = b == last ? FLT_MAX : lo + (b + 1) * width;
+                grow(bins[b].box, clip(r, a, b_lo, b_hi).box);
+            }
+
+            ++bins[first].entries;
+            ++bins[last].exits;
+        }
+
+        aabb right_box[kBins];
+        int right_count[kBins];
+        aabb acc = empty_box();
+        int count = 0;
+
+        for(int b = kBins - 1; b > 0; --b) {
+            grow(acc, bins[b].box);
+            count += bins[b].exits;
+            right_box[b] = acc;
+            right_count[b] = count;
+        }
+
+        acc = empty_box();
+        count = 0;
+
+        for(int b = 0; b < kBins - 1; ++b) {
+            grow(acc, bins[b].box);
+            count += bins[b].entries;
+
+            if(count == 0 || right_count[b + 1] == 0)
+                continue;
+
+            float cost = count * acc.surface_area() + right_count[b + 1] * right_box[b + 1].surface_area();
+
+            if(cost < best.cost) {
+                best.cost = cost;
+                best.axis = a;
+                best.bin = b;
+                best.left = acc;
+                best.right = right_box[b + 1];
+                best.left_count = count;
+                best.right_count = right_count[b + 1];
+            }
+        }
+    }
+}
+
+bvh_build_node *bvh_builder::sbvh_leaf(bvh_build_node *node, const std::vector<bvh_prim_ref> &work)
+{
+    std::lock_guard<std::mutex> lock(leaf_mutex);
+
+    node->child[0] = node->child[1] = nullptr;
+    node->first = int(refs.size());
+    node->count = int(work.size());
+    node->axis = 0;
+    refs.insert(refs.end(), work.begin(), work.end());
+
+    return node;
+}
+
+bvh_build_node *bvh_builder::sbvh(std::vector<bvh_prim_ref> &work, int depth)
+{
+    bvh_build_node *node = new bvh_build_node;
+    ++node_count;
+
+    int n = int(work.size());
+    aabb cbox;
+    range_bounds(work.data(), 0, n, node->box, cbox);
+
+    if( n == 1 || depth >= kBVHMaxDepth - 1 )
+        return sbvh_leaf(node, work);
+
+    sbvh_split object, spatial;
+    object_split(work, cbox, object);
+    spatial.bin = -1;
+
+    // Only worth it where the object split children overlap, and while the budget lasts.
+    if( object.bin >= 0 && ref_total < ref_budget ) {
+        aabb overlap = object.left;
+        for(int a = 0; a < 3; ++a) {
+            overlap._min[a] = ffmax(object.left.min()[a], object.right.min()[a]);
+            overlap._max[a] = ffmin(object.left.max()[a], object.right.max()[a]);
+        }
+
+        // Flat overlaps count, two walls meeting at a corner have one.
+        bool overlaps = overlap.min().x() <= overlap.max().x() &&
+                        overlap.min().y() <= overlap.max().y() &&
+                        overlap.min().z() <= overlap.max().z();
+
+        if( overlaps && overlap.surface_area() > kSBVHOverlap * root_area )
+            spatial_split(work, node->box, spatial);
+    }
+
+    bool use_spatial = spatial.bin >= 0 && spatial.cost < object.cost;
+    const sbvh_split &best = use_spatial ? spatial : object;
+
+    float node_area = node->box.surface_area();
+    float split_cost = kTraversalCost + (node_area > 0.0 ? best.cost / node_area : 0.0);
+
+    if( n <= kMaxLeafSize && (best.bin < 0 || split_cost >= n) )
+        return sbvh_leaf(node, work);
+
+    std::vector<bvh_prim_ref> left, right;
+    int axis = best.axis;
+
+    if( use_spatial ) {
+        float lo = node->box.min()[axis];
+        float extent = node->box.max()[axis] - lo;
+        float position = lo + (best.bin + 1) * (extent / kBins);
+        aabb left_box = best.left,
+             right_box = best.right;
+        int left_count = best.left_count,
+            right_count = best.right_count;
+        int duplicates = 0;
+
+        for(const bvh_prim_ref &r : work) {
+            int first = bin_index(r.box.min()[axis], lo, extent, kBins);
+            int last = bin_index(r.box.max()[axis], lo, extent, kBins);
+
+            if( last <= best.bin ) {
+                left.push_back(r);
+                continue;
+            }
+            if( first > best.bin ) {
+                right.push_back(r);
+                continue;
+            }
+
+            // Straddles the plane: split it, unless putting it whole on one side is cheaper.
+            aabb left_grown = left_box,
+                 right_grown = right_box;
+            grow(left_grown, r.box);
+            grow(right_grown, r.box);
+
+            float split = left_count * left_box.surface_area() + right_count * right_box.surface_area();
+            float to_left = left_count * left_grown.surface_area() + (right_count - 1) * right_box.surface_area();
+            float to_right = (left_count - 1) * left_box.surface_area() + right_count * right_grown.surface_area();
+
+            if( split <= to_left && split <= to_right && list[r.index]->splittable() ) {
+                left.push_back(clip(r, axis, -FLT_MAX, position));
+                right.push_back(clip(r, axis, position, FLT_MAX));
+                ++duplicates;
+            }
+            else if( to_left <= to_right ) {
+                left.push_back(r);
+                left_box = left_grown;
+                --right_count;
+            }
+            else {
+                right.push_back(r);
+                right_box = right_grown;
+                --left_count;
+            }
+        }
+
+        ref_total += duplicates;
+
+        if( left.empty() || right.empty() ) {
+            left.clear();
+            right.clear();
+            use_spatial = false;
+        }
+    }
+
+    if( !use_spatial ) {
+        if( object.bin >= 0 ) {
+            axis = object.axis;
+            float lo = cbox.min()[axis];
+            float extent = cbox.max()[axis] - lo;
+            int nbins = bin_count(n);
+
+            for(const bvh_prim_ref &r : work) {
+                if( bin_index(r.centroid[axis], lo, extent, nbins) <= object.bin )
+                    left.push_back(r);
+                else
+                    right.push_back(r);
+            }
+        }
+        else {
+            // All centroids fell in one bin, fall back to the object median.
+            vec3 extent = cbox.max() - cbox.min();
+            axis = extent.x() > extent.y() ? (extent.x() > extent.z() ? 0 : 2) : (extent.y() > extent.z() ? 1 : 2);
+            std::nth_element(work.begin(), work.begin() + n / 2, work.end(),
+                [=](const bvh_prim_ref &a, const bvh_prim_ref &b) { return a.centroid[axis] < b.centroid[axis]; });
+            left.assign(work.begin(), work.begin() + n / 2);
+            right.assign(work.begin() + n / 2, work.end());
+        }
+    }
+
+    node->axis = axis;
+    node->first = node->count = 0;
+
+    // The children have their own copies, the parent's is not needed further down.
+    std::vector<bvh_prim_ref>().swap(work);
+
+    if( n >= kSpawnThreshold && active_threads.fetch_add(1) < max_threads ) {
+        std::thread left_thread([&]() { perf_phase_scope scope(perf_phase_bvh); node->child[0] = sbvh(left, depth + 1); });
+        node->child[1] = sbvh(right, depth + 1);
+        left_thread.join();
+        --active_threads;
+    }
+    else {
+        if( n >= kSpawnThreshold )
+            --active_threads;
+
+        node->child[0] = sbvh(left, depth + 1);
+        node->child[1] = sbvh(right, depth + 1);
+    }
+
+    return node;
+}
+
+bvh_build_node *bvh_builder::build_sbvh()
+{
+    int n = int(refs.size());
+    std::vector<bvh_prim_ref> work;
+    work.swap(refs);
+
+    ref_total = n;
+    ref_budget = int(n * (1.0 + kSBVHMaxGrowth));
+    refs.reserve(ref_budget);
+
+    aabb box, cbox;
+    range_bounds(work.data(), 0, n, box, cbox);
+    root_area = box.surface_area();
+
+    return sbvh(work, 0);
+}
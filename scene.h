@@ -0,0 +1,28 @@
+#ifndef __SCENE_H__
+#define __SCENE_H__
+
+#include "hitables.h"
+#include "camera.h"
+#include "bvh_node.h"
+#include "environment.h"
+
+struct scene
+{
+    hitable *world;
+    hitable *lights = nullptr;  // Emitters for light sampling, also in world. Null if the scene lists none.
+    environment_map *environment = nullptr;     // What rays that miss the world see, black when null.
+    camera  *cam;
+    int nx, ny, ns;
+    bvh_build_method accel;     // Builder for the scene BVHs.
+    const char *cache_dir;      // Where built BVHs are kept between runs, null to always build.
+    unsigned int seed;          // Scenes are random, a fixed seed lets their cached BVHs be reused.
+};
+
+// A named scene builder, it sets the world, lights, environment and the camera of the_scene.
+struct scene_entry
+{
+    const char *name;
+    void (*build)(scene &the_scene);
+};
+
+#endif // __SCENE_H__
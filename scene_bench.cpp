@@ -0,0 +1,210 @@
+#include "scene_bench.h"
+#include "compile.h"
+#include "parallel.h"
+#include "rangen.h"
+#include "memory_stats.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct scene_result
+{
+    std::string name;
+    double      build_seconds,      // Scene builder plus compile_world.
+                render_seconds,
+                mrays;              // Millions of rays per second.
+    uint64_t    rays;
+    double      peak_rss_mb;        // -1 where it can not be measured.
+};
+
+//
+// RESULTS
+//
+
+static void write_csv(std::ostream &os, const std::vector<scene_result> &results, const scene_bench_options &options)
+{
+    os << "scene,width,height,spp,threads,build_seconds,render_seconds,rays,mrays_per_second,peak_rss_mb\n";
+
+    for(const scene_result &r : results) {
+        os << r.name << "," << options.nx << "," << options.ny << "," << options.ns << "," << hardware_threads() << ","
+           << r.build_seconds << "," << r.render_seconds << "," << r.rays << "," << r.mrays << "," << r.peak_rss_mb << "\n";
+    }
+}
+
+static void write_json(std::ostream &os, const std::vector<scene_result> &results, const scene_bench_options &options)
+{
+    os << "{\n  \"width\": " << options.nx << ", \"height\": " << options.ny << ", \"spp\": " << options.ns
+       << ", \"seed\": " << options.seed << ", \"threads\": " << hardware_threads()
+       << ",\n  \"mode\": \"" << (options.render.mode == render_wavefront ? "wavefront" : "scalar") << "\",\n  \"scenes\": [";
+
+    for(size_t i = 0; i < results.size(); ++i) {
+        const scene_result &r = results[i];
+        os << (i ? ",\n" : "\n") << "    {\"scene\": \"" << r.name << "\", \"build_seconds\": " << r.build_seconds
+           << ", \"render_seconds\": " << r.render_seconds << ", \"rays\": " << r.rays
+           << ", \"mrays_per_second\": " << r.mrays << ", \"peak_rss_mb\": " << r.peak_rss_mb << "}";
+    }
+
+    os << "\n  ]\n}\n";
+}
+
+// Results of an earlier run, as write_csv wrote them.
+static bool read_csv(const char *path, std::vector<scene_result> &results)
+{
+    std::ifstream file(path);
+    std::string line;
+
+    if( !file || !std::getline(file, line) )
+        return false;
+
+    while( std::getline(file, line) ) {
+        std::vector<std::string> fields;
+        std::stringstream row(line);
+        std::string field;
+
+        while( std::getline(row, field, ',') )
+            fields.push_back(field);
+
+        if( fields.size() < 10 )
+            continue;
+
+        scene_result r;
+        r.name = fields[0];
+        r.build_seconds = atof(fields[5].c_str());
+        r.render_seconds = atof(fields[6].c_str());
+        r.rays = strtoull(fields[7].c_str(), nullptr, 10);
+        r.mrays = atof(fields[8].c_str());
+        r.peak_rss_mb = atof(fields[9].c_str());
+        results.push_back(r);
+    }
+
+    return true;
+}
+
+// Prints the change of every scene against the baseline. False if any got
+// slower than the threshold.
+static bool compare(const std::vector<scene_result> &results, const std::vector<scene_result> &baseline, double threshold)
+{
+    bool ok = true;
+
+    std::cout << std::left << std::setw(20) << "scene" << std::right << std::setw(12) << "build" << std::setw(12) << "render"
+              << std::setw(12) << "Mrays/s" << std::setw(12) << "memory\n";
+
+    for(const scene_result &r : results) {
+        const scene_result *base = nullptr;
+        for(const scene_result &b : baseline) {
+            if( b.name == r.name )
+                base = &b;
+        }
+
+        std::cout << std::left << std::setw(20) << r.name << std::right << std::fixed << std::setprecision(1);
+
+        if( !base ) {
+            std::cout << "  not in the baseline\n";
+            continue;
+        }
+
+        // Positive is worse for every column.
+        double build = r.build_seconds / base->build_seconds - 1.0,
+               render = r.render_seconds / base->render_seconds - 1.0,
+               mrays = base->mrays / r.mrays - 1.0,
+               memory = base->peak_rss_mb > 0.0 && r.peak_rss_mb > 0.0 ? r.peak_rss_mb / base->peak_rss_mb - 1.0 : 0.0;
+
+        std::cout << std::showpos << std::setw(11) << 100.0 * build << "%" << std::setw(11) << 100.0 * render << "%"
+                  << std::setw(11) << -100.0 * mrays << "%" << std::setw(11) << 100.0 * memory << "%" << std::noshowpos;
+
+        if( render > threshold || mrays > threshold ) {
+            std::cout << "  REGRESSION";
+            ok = false;
+        }
+        else if( build > threshold )
+            std::cout << "  slower build";
+        else if( render < -threshold )
+            std::cout << "  faster";
+
+        std::cout << "\n";
+    }
+
+    std::cout.unsetf(std::ios::fixed);
+    return ok;
+}
+
+//
+// HARNESS
+//
+
+bool run_scene_benchmarks(const scene_entry *scenes, int count, const char *filter, const scene_bench_options &options)
+{
+    std::vector<scene_result> results;
+
+    // Before any build, so the builds and the threads column use the limit too.
+    set_thread_limit(options.render.threads);
+
+    for(int i = 0; i < count; ++i) {
+        if( filter && !strstr(scenes[i].name, filter) )
+            continue;
+
+        scene the_scene;
+        the_scene.nx = options.nx;
+        the_scene.ny = options.ny;
+        the_scene.ns = options.ns;
+        the_scene.accel = options.accel;
+        the_scene.cache_dir = nullptr;
+        the_scene.seed = options.seed;
+
+        std::cerr << "Benchmark: " << scenes[i].name << "\n";
+        // The scenes benchmarked before are never freed, so they stay in the peak.
+        reset_peak_rss();
+        seed_drand48(the_scene.seed);
+
+        scene_result r;
+        r.name = scenes[i].name;
+
+        auto start = std::chrono::steady_clock::now();
+        scenes[i].build(the_scene);
+        the_scene.world = compile_world(the_scene.world, the_scene.cam->time0, the_scene.cam->time1, the_scene.accel, nullptr);
+        the_scene.lights = make_light_sampler(the_scene.lights, the_scene.cam->time0, the_scene.cam->time1, options.render.light_sampler);
+        r.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        vec3 *image = new vec3[the_scene.nx * the_scene.ny];
+
+        start = std::chrono::steady_clock::now();
+        r.rays = render(the_scene, options.render, image);
+        r.render_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        r.mrays = r.rays / r.render_seconds * 1e-6;
+        r.peak_rss_mb = peak_rss_mb();
+
+        delete [] image;
+        results.push_back(r);
+    }
+
+    if( results.empty() ) {
+        std::cerr << "No scene matches " << filter << "\n";
+        return false;
+    }
+
+    std::string output = options.output;
+    std::ofstream csv(output + ".csv");
+    std::ofstream json(output + ".json");
+    write_csv(csv, results, options);
+    write_json(json, results, options);
+
+    if( !options.baseline ) {
+        write_csv(std::cout, results, options);
+        return true;
+    }
+
+    std::vector<scene_result> baseline;
+    if( !read_csv(options.baseline, baseline) ) {
+        std::cerr << "Could not read the baseline " << options.baseline << "\n";
+        return false;
+    }
+
+    return compare(results, baseline, options.threshold);
+}
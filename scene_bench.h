@@ -0,0 +1,24 @@
+#ifndef __SCENE_BENCH_H__
+#define __SCENE_BENCH_H__
+
+#include "scene.h"
+#include "render.h"
+
+struct scene_bench_options
+{
+    int nx, ny, ns;
+    unsigned int seed;
+    bvh_build_method accel;
+    render_options render;
+    const char *output,         // Results go to output.csv and output.json.
+               *baseline;       // CSV of an earlier run to compare with, null for none.
+    double threshold;           // Relative slowdown reported as a regression, 0.05 for 5%.
+};
+
+// Builds and renders, without the BVH cache, every scene whose name contains
+// filter, or all of them with nullptr, recording build and render time,
+// Mrays/s and peak resident memory. False when no scene matched or, with a
+// baseline, when a scene got slower than the threshold allows.
+bool run_scene_benchmarks(const scene_entry *scenes, int count, const char *filter, const scene_bench_options &options);
+
+#endif // __SCENE_BENCH_H__
@@ -0,0 +1,131 @@
+#include "stats.h"
+#include "materials.h"
+
+#include <string.h>
+#include <mutex>
+
+static_assert(kStatMaterials == material_kinds, "kStatMaterials must follow material_kind");
+
+static std::mutex merged_mutex;
+static trace_stats merged;      // Of the threads that already exited.
+
+#ifdef RT_STATS
+static const int kStatWords = sizeof(trace_stats) / sizeof(uint64_t);
+
+static void add(trace_stats &to, const trace_stats &from)
+{
+    uint64_t *a = reinterpret_cast<uint64_t *>(&to);
+    const uint64_t *b = reinterpret_cast<const uint64_t *>(&from);
+
+    for(int i = 0; i < kStatWords; ++i)
+        a[i] += b[i];
+}
+
+thread_local trace_stats tls_trace_stats;
+thread_local bool tls_trace_stats_registered = false;
+
+// Adds the thread's counters to the merged ones when it exits.
+struct thread_stats_flusher
+{
+    ~thread_stats_flusher()
+    {
+        std::lock_guard<std::mutex> lock(merged_mutex);
+        add(merged, tls_trace_stats);
+    }
+};
+
+void register_thread_stats()
+{
+    static thread_local thread_stats_flusher flusher;
+    (void)flusher;
+    tls_trace_stats_registered = true;
+}
+#endif
+
+trace_stats collect_stats()
+{
+    std::lock_guard<std::mutex> lock(merged_mutex);
+    trace_stats s = merged;
+
+#ifdef RT_STATS
+    add(s, tls_trace_stats);
+#endif
+
+    return s;
+}
+
+void reset_stats()
+{
+    std::lock_guard<std::mutex> lock(merged_mutex);
+    memset(&merged, 0, sizeof(merged));
+
+#ifdef RT_STATS
+    memset(&tls_trace_stats, 0, sizeof(tls_trace_stats));
+#endif
+}
+
+static uint64_t total_rays(const trace_stats &s)
+{
+    uint64_t n = 0;
+    for(int t = 0; t < stat_ray_types; ++t)
+        n += s.rays[t];
+    return n;
+}
+
+static double mean_path_length(const trace_stats &s)
+{
+    uint64_t paths = 0,
+             rays = 0;
+
+    for(int b = 0; b < kPathLengthBins; ++b) {
+        paths += s.path_lengths[b];
+        rays += s.path_lengths[b] * b;
+    }
+
+    return paths > 0 ? double(rays) / paths : 0.0;
+}
+
+std::ostream& operator<<(std::ostream &os, const trace_stats &s)
+{
+    uint64_t n = total_rays(s);
+    double rays = n > 0 ? double(n) : 1.0;
+
+    os << n << " rays (" << s.rays[stat_ray_camera] << " camera, " << s.rays[stat_ray_scatter] << " scatter, "
+       << s.rays[stat_ray_shadow] << " shadow), " << s.bvh_nodes / rays << " BVH nodes and "
+       << s.prim_tests / rays << " primitive tests per ray, " << mean_path_length(s) << " rays per path";
+
+    return os;
+}
+
+static void write_array(std::ostream &os, const char *name, const uint64_t *values, const char *const *names, int n)
+{
+    os << "    \"" << name << "\": {";
+    for(int i = 0; i < n; ++i)
+        os << (i > 0 ? ", " : "") << "\"" << names[i] << "\": " << values[i];
+    os << "}";
+}
+
+void write_json(std::ostream &os, const trace_stats &s)
+{
+    const char *ray_names[stat_ray_types] = { "camera", "scatter", "shadow" };
+    const char *prim_names[stat_prims] = { "sphere", "moving_sphere", "rect", "plane", "box", "instance", "constant_medium" };
+    const char *material_names[kStatMaterials] = { "lambertian", "metal", "dielectric", "isotropic", "diffuse_light", "other" };
+    const char *texture_names[stat_textures] = { "constant", "checker", "noise", "image" };
+    const char *end_names[stat_path_ends] = { "miss", "absorbed", "max_depth", "russian_roulette" };
+
+    os << "{\n";
+    write_array(os, "rays", s.rays, ray_names, stat_ray_types);
+    os << ",\n    \"bvh_nodes\": " << s.bvh_nodes
+       << ",\n    \"prim_tests\": " << s.prim_tests << ",\n";
+    write_array(os, "prim_tests_by_class", s.prim_class_tests, prim_names, stat_prims);
+    os << ",\n";
+    write_array(os, "scatter_calls", s.scatter_calls, material_names, kStatMaterials);
+    os << ",\n";
+    write_array(os, "texture_lookups", s.texture_lookups, texture_names, stat_textures);
+    os << ",\n";
+    write_array(os, "path_ends", s.path_ends, end_names, stat_path_ends);
+    os << ",\n    \"path_lengths\": [";
+    for(int b = 0; b < kPathLengthBins; ++b)
+        os << (b > 0 ? ", " : "") << s.path_lengths[b];
+    os << "]\n}";
+}
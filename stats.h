@@ -0,0 +1,102 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+#include <iostream>
+
+// Render counters. They cost nothing unless built with -DRT_STATS. Every
+// thread counts in its own copy, merged when it exits or when collected.
+
+enum stat_ray
+{
+    stat_ray_camera,
+    stat_ray_scatter,
+    stat_ray_shadow,
+    stat_ray_types
+};
+
+enum stat_prim
+{
+    stat_sphere,
+    stat_moving_sphere,
+    stat_rect,
+    stat_plane,
+    stat_box,
+    stat_instance,      // translate, rotate_y and flip_normals.
+    stat_medium,
+    stat_prims
+};
+
+enum stat_texture
+{
+    stat_constant_texture,
+    stat_checker_texture,
+    stat_noise_texture,
+    stat_image_texture,
+    stat_textures
+};
+
+// How a path ended.
+enum stat_path_end
+{
+    stat_end_miss,
+    stat_end_absorbed,  // sample() returned false, lights included.
+    stat_end_max_depth,
+    stat_end_roulette,
+    stat_path_ends
+};
+
+const int kStatMaterials = 6;       // material_kinds, materials.h includes this file.
+const int kPathLengthBins = 64;     // Rays per path, the last bin takes the longer ones.
+
+// Only uint64_t members, they are merged as an array.
+struct trace_stats
+{
+    uint64_t    rays[stat_ray_types],
+                bvh_nodes,                      // BVH nodes whose box was tested.
+                prim_tests,                     // Primitives tested from BVH leaves and lists.
+                prim_class_tests[stat_prims],   // Tests by the primitives themselves, packet lanes included.
+                scatter_calls[kStatMaterials],  // By material_kind.
+                texture_lookups[stat_textures],
+                path_lengths[kPathLengthBins],
+                path_ends[stat_path_ends];
+};
+
+#ifdef RT_STATS
+extern thread_local trace_stats tls_trace_stats;
+extern thread_local bool tls_trace_stats_registered;
+
+void register_thread_stats();
+
+inline trace_stats &thread_stats()
+{
+    if( !tls_trace_stats_registered )
+        register_thread_stats();
+    return tls_trace_stats;
+}
+
+inline void record_path(int rays, stat_path_end end)
+{
+    trace_stats &s = thread_stats();
+    ++s.path_lengths[rays < kPathLengthBins ? rays : kPathLengthBins - 1];
+    ++s.path_ends[end];
+}
+
+#define RT_STAT(counter) (++thread_stats().counter)
+#define RT_STAT_ADD(counter, n) (thread_stats().counter += (n))
+#define RT_STAT_PATH(rays, end) record_path(rays, end)
+#else
+#define RT_STAT(counter) ((void)0)
+#define RT_STAT_ADD(counter, n) ((void)0)
+#define RT_STAT_PATH(rays, end) ((void)0)
+#endif
+
+// Totals of the threads that exited plus the calling one. Call with the
+// workers joined.
+trace_stats collect_stats();
+void reset_stats();
+
+std::ostream& operator<<(std::ostream &os, const trace_stats &s);
+void write_json(std::ostream &os, const trace_stats &s);
+
+#endif // __STATS_H__
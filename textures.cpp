@@ -1,6 +1,7 @@
 #include "textures.h"
 
 vec3 image_texture::value(float u, float v, const vec3& p) const {
+     RT_STAT(texture_lookups[stat_image_texture]);
      int i = (  u)*nx;
      int j = (1-v)*ny - 0.001;
      if (i < 0) i = 0;
@@ -12,3 +13,15 @@ vec3 image_texture::value(float u, float v, const vec3& p) const {
      float b = int(data[3*i + 3*nx*j+2]) / 255.0;
      return vec3(r, g, b);
 }
+
+// Every texel covers as much of the square.
+vec3 image_texture::average(const vec3 &p) const
+{
+    double sum[3] = {0.0, 0.0, 0.0};
+
+    for(long long i = 0; i < 3LL * nx * ny; ++i)
+        sum[i % 3] += data[i];
+
+    double scale = 1.0 / (255.0 * nx * ny);
+    return vec3(sum[0] * scale, sum[1] * scale, sum[2] * scale);
+}
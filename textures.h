@@ -3,11 +3,18 @@
 
 #include "vec3.h"
 #include "perlin.h"
+#include "stats.h"
+#include "memory_stats.h"
 
 class texture
 {
     public:
+        RT_MEMORY_CATEGORY(memory_textures)
+        
         virtual vec3 value(float u, float v, const vec3 &p) const = 0;
+        
+        // Over the whole (u, v) square, for the power of emitters.
+        virtual vec3 average(const vec3 &p) const { return value(0.5, 0.5, p); }
     
 };
 
@@ -22,8 +29,10 @@ class constant_texture : public texture
         constant_texture(vec3 c) : color(c) {}
         virtual vec3 value(float u, float v, const vec3 &p) const
         {
+            RT_STAT(texture_lookups[stat_constant_texture]);
             return color;
         }
+        virtual vec3 average(const vec3 &p) const { return color; }
         
         vec3 color;
 };
@@ -40,12 +49,14 @@ class checker_texture : public texture
         
         virtual vec3 value(float u, float v, const vec3 &p) const
         {
+            RT_STAT(texture_lookups[stat_checker_texture]);
             float sines = std::sin(10 * p.x()) * std::sin(10 * p.y()) * std::sin(10 * p.z());
             if( sines < 0.0 )
                 return odd->value(u, v, p);
             else
                 return even->value(u, v, p);
         }
+        virtual vec3 average(const vec3 &p) const { return 0.5 * (even->average(p) + odd->average(p)); }
         
         texture *even,
                 *odd;
@@ -62,6 +73,7 @@ class noise_texture : public texture
         noise_texture(float sc) : scale(sc) {}
         virtual vec3 value(float u, float v, const vec3 &p) const
         {
+            RT_STAT(texture_lookups[stat_noise_texture]);
             return vec3(1.0, 1.0, 1.0)*0.5*(1.0 + std::sin(scale * p.z() + 10.0 * noise.turb(p)));
         }
         
@@ -74,8 +86,12 @@ class noise_texture : public texture
 class image_texture : public texture {
     public:
         image_texture() {}
-        image_texture(unsigned char *pixels, int A, int B) : data(pixels), nx(A), ny(B) {}
+        image_texture(unsigned char *pixels, int A, int B) : data(pixels), nx(A), ny(B)
+        {
+            account_memory(memory_textures, 3LL * nx * ny, 0);
+        }
         virtual vec3 value(float u, float v, const vec3& p) const;
+        virtual vec3 average(const vec3 &p) const;
         
         unsigned char *data;
         int nx, 
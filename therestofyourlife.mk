@@ -37,7 +37,7 @@ PCHCompileFlags        :=
 MakeDirCommand         :=makedir
 RcCmpOptions           := 
 RcCompilerName         :=C:/TDM-GCC-32/bin/windres.exe
-LinkOptions            :=  
+LinkOptions            :=  -pthread
 IncludePath            :=  $(IncludeSwitch). $(IncludeSwitch). 
 IncludePCH             := 
 RcIncludePath          := 
@@ -52,7 +52,7 @@ LibPath                := $(LibraryPathSwitch).
 AR       := C:/TDM-GCC-32/bin/ar.exe rcu
 CXX      := C:/TDM-GCC-32/bin/g++.exe
 CC       := C:/TDM-GCC-32/bin/gcc.exe
-CXXFLAGS :=  -g -O0 -std=c++14 -Wall $(Preprocessors)
+CXXFLAGS :=  -g -O0 -std=c++14 -Wall -pthread $(Preprocessors)
 CFLAGS   :=  -g -O0 -Wall $(Preprocessors)
 ASFLAGS  := 
 AS       := C:/TDM-GCC-32/bin/as.exe
@@ -63,7 +63,7 @@ AS       := C:/TDM-GCC-32/bin/as.exe
 ##
 CodeLiteDir:=C:\Archivos de programa\CodeLite
 WXWIN:=C:/wx302
-Objects0=$(IntermediateDirectory)/main.cpp$(ObjectSuffix) $(IntermediateDirectory)/hitables.cpp$(ObjectSuffix) $(IntermediateDirectory)/textures.cpp$(ObjectSuffix) $(IntermediateDirectory)/materials.cpp$(ObjectSuffix) $(IntermediateDirectory)/rangen.cpp$(ObjectSuffix) $(IntermediateDirectory)/vec3.cpp$(ObjectSuffix) $(IntermediateDirectory)/aabb.cpp$(ObjectSuffix) $(IntermediateDirectory)/perlin.cpp$(ObjectSuffix) 
+Objects0=$(IntermediateDirectory)/main.cpp$(ObjectSuffix) $(IntermediateDirectory)/hitables.cpp$(ObjectSuffix) $(IntermediateDirectory)/textures.cpp$(ObjectSuffix) $(IntermediateDirectory)/materials.cpp$(ObjectSuffix) $(IntermediateDirectory)/rangen.cpp$(ObjectSuffix) $(IntermediateDirectory)/vec3.cpp$(ObjectSuffix) $(IntermediateDirectory)/aabb.cpp$(ObjectSuffix) $(IntermediateDirectory)/perlin.cpp$(ObjectSuffix) $(IntermediateDirectory)/bvh_node.cpp$(ObjectSuffix) $(IntermediateDirectory)/lbvh.cpp$(ObjectSuffix) $(IntermediateDirectory)/mapped_file.cpp$(ObjectSuffix) $(IntermediateDirectory)/bvh_cache.cpp$(ObjectSuffix) $(IntermediateDirectory)/instances.cpp$(ObjectSuffix) $(IntermediateDirectory)/constant_medium.cpp$(ObjectSuffix) $(IntermediateDirectory)/compile.cpp$(ObjectSuffix) $(IntermediateDirectory)/stats.cpp$(ObjectSuffix) $(IntermediateDirectory)/sbvh.cpp$(ObjectSuffix) $(IntermediateDirectory)/geometry.cpp$(ObjectSuffix) $(IntermediateDirectory)/render.cpp$(ObjectSuffix) $(IntermediateDirectory)/morton.cpp$(ObjectSuffix) $(IntermediateDirectory)/perf_counters.cpp$(ObjectSuffix) $(IntermediateDirectory)/image_io.cpp$(ObjectSuffix) $(IntermediateDirectory)/heatmap.cpp$(ObjectSuffix) $(IntermediateDirectory)/bench.cpp$(ObjectSuffix) $(IntermediateDirectory)/scene_bench.cpp$(ObjectSuffix) $(IntermediateDirectory)/converge.cpp$(ObjectSuffix) $(IntermediateDirectory)/timeline.cpp$(ObjectSuffix) $(IntermediateDirectory)/memory_stats.cpp$(ObjectSuffix) $(IntermediateDirectory)/light_tree.cpp$(ObjectSuffix) $(IntermediateDirectory)/alias_table.cpp$(ObjectSuffix) $(IntermediateDirectory)/environment.cpp$(ObjectSuffix) $(IntermediateDirectory)/bdpt.cpp$(ObjectSuffix) 
 
 
 
@@ -158,6 +158,198 @@ $(IntermediateDirectory)/perlin.cpp$(DependSuffix): perlin.cpp
 $(IntermediateDirectory)/perlin.cpp$(PreprocessSuffix): perlin.cpp
 	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/perlin.cpp$(PreprocessSuffix) perlin.cpp
 
+$(IntermediateDirectory)/bvh_node.cpp$(ObjectSuffix): bvh_node.cpp $(IntermediateDirectory)/bvh_node.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/bvh_node.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/bvh_node.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/bvh_node.cpp$(DependSuffix): bvh_node.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/bvh_node.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/bvh_node.cpp$(DependSuffix) -MM bvh_node.cpp
+
+$(IntermediateDirectory)/bvh_node.cpp$(PreprocessSuffix): bvh_node.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/bvh_node.cpp$(PreprocessSuffix) bvh_node.cpp
+
+$(IntermediateDirectory)/lbvh.cpp$(ObjectSuffix): lbvh.cpp $(IntermediateDirectory)/lbvh.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/lbvh.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/lbvh.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/lbvh.cpp$(DependSuffix): lbvh.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/lbvh.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/lbvh.cpp$(DependSuffix) -MM lbvh.cpp
+
+$(IntermediateDirectory)/lbvh.cpp$(PreprocessSuffix): lbvh.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/lbvh.cpp$(PreprocessSuffix) lbvh.cpp
+
+$(IntermediateDirectory)/mapped_file.cpp$(ObjectSuffix): mapped_file.cpp $(IntermediateDirectory)/mapped_file.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/mapped_file.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/mapped_file.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/mapped_file.cpp$(DependSuffix): mapped_file.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/mapped_file.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/mapped_file.cpp$(DependSuffix) -MM mapped_file.cpp
+
+$(IntermediateDirectory)/mapped_file.cpp$(PreprocessSuffix): mapped_file.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/mapped_file.cpp$(PreprocessSuffix) mapped_file.cpp
+
+$(IntermediateDirectory)/bvh_cache.cpp$(ObjectSuffix): bvh_cache.cpp $(IntermediateDirectory)/bvh_cache.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/bvh_cache.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/bvh_cache.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/bvh_cache.cpp$(DependSuffix): bvh_cache.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/bvh_cache.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/bvh_cache.cpp$(DependSuffix) -MM bvh_cache.cpp
+
+$(IntermediateDirectory)/bvh_cache.cpp$(PreprocessSuffix): bvh_cache.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/bvh_cache.cpp$(PreprocessSuffix) bvh_cache.cpp
+
+$(IntermediateDirectory)/instances.cpp$(ObjectSuffix): instances.cpp $(IntermediateDirectory)/instances.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/instances.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/instances.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/instances.cpp$(DependSuffix): instances.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/instances.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/instances.cpp$(DependSuffix) -MM instances.cpp
+
+$(IntermediateDirectory)/instances.cpp$(PreprocessSuffix): instances.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/instances.cpp$(PreprocessSuffix) instances.cpp
+
+$(IntermediateDirectory)/constant_medium.cpp$(ObjectSuffix): constant_medium.cpp $(IntermediateDirectory)/constant_medium.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/constant_medium.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/constant_medium.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/constant_medium.cpp$(DependSuffix): constant_medium.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/constant_medium.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/constant_medium.cpp$(DependSuffix) -MM constant_medium.cpp
+
+$(IntermediateDirectory)/constant_medium.cpp$(PreprocessSuffix): constant_medium.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/constant_medium.cpp$(PreprocessSuffix) constant_medium.cpp
+
+$(IntermediateDirectory)/compile.cpp$(ObjectSuffix): compile.cpp $(IntermediateDirectory)/compile.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/compile.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/compile.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/compile.cpp$(DependSuffix): compile.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/compile.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/compile.cpp$(DependSuffix) -MM compile.cpp
+
+$(IntermediateDirectory)/compile.cpp$(PreprocessSuffix): compile.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/compile.cpp$(PreprocessSuffix) compile.cpp
+
+$(IntermediateDirectory)/stats.cpp$(ObjectSuffix): stats.cpp $(IntermediateDirectory)/stats.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/stats.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/stats.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/stats.cpp$(DependSuffix): stats.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/stats.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/stats.cpp$(DependSuffix) -MM stats.cpp
+
+$(IntermediateDirectory)/stats.cpp$(PreprocessSuffix): stats.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/stats.cpp$(PreprocessSuffix) stats.cpp
+
+$(IntermediateDirectory)/sbvh.cpp$(ObjectSuffix): sbvh.cpp $(IntermediateDirectory)/sbvh.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/sbvh.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/sbvh.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/sbvh.cpp$(DependSuffix): sbvh.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/sbvh.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/sbvh.cpp$(DependSuffix) -MM sbvh.cpp
+
+$(IntermediateDirectory)/sbvh.cpp$(PreprocessSuffix): sbvh.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/sbvh.cpp$(PreprocessSuffix) sbvh.cpp
+
+$(IntermediateDirectory)/geometry.cpp$(ObjectSuffix): geometry.cpp $(IntermediateDirectory)/geometry.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/geometry.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/geometry.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/geometry.cpp$(DependSuffix): geometry.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/geometry.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/geometry.cpp$(DependSuffix) -MM geometry.cpp
+
+$(IntermediateDirectory)/geometry.cpp$(PreprocessSuffix): geometry.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/geometry.cpp$(PreprocessSuffix) geometry.cpp
+
+$(IntermediateDirectory)/render.cpp$(ObjectSuffix): render.cpp $(IntermediateDirectory)/render.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/render.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/render.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/render.cpp$(DependSuffix): render.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/render.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/render.cpp$(DependSuffix) -MM render.cpp
+
+$(IntermediateDirectory)/render.cpp$(PreprocessSuffix): render.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/render.cpp$(PreprocessSuffix) render.cpp
+
+$(IntermediateDirectory)/morton.cpp$(ObjectSuffix): morton.cpp $(IntermediateDirectory)/morton.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/morton.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/morton.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/morton.cpp$(DependSuffix): morton.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/morton.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/morton.cpp$(DependSuffix) -MM morton.cpp
+
+$(IntermediateDirectory)/morton.cpp$(PreprocessSuffix): morton.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/morton.cpp$(PreprocessSuffix) morton.cpp
+
+$(IntermediateDirectory)/perf_counters.cpp$(ObjectSuffix): perf_counters.cpp $(IntermediateDirectory)/perf_counters.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/perf_counters.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/perf_counters.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/perf_counters.cpp$(DependSuffix): perf_counters.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/perf_counters.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/perf_counters.cpp$(DependSuffix) -MM perf_counters.cpp
+
+$(IntermediateDirectory)/perf_counters.cpp$(PreprocessSuffix): perf_counters.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/perf_counters.cpp$(PreprocessSuffix) perf_counters.cpp
+
+$(IntermediateDirectory)/image_io.cpp$(ObjectSuffix): image_io.cpp $(IntermediateDirectory)/image_io.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/image_io.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/image_io.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/image_io.cpp$(DependSuffix): image_io.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/image_io.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/image_io.cpp$(DependSuffix) -MM image_io.cpp
+
+$(IntermediateDirectory)/image_io.cpp$(PreprocessSuffix): image_io.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/image_io.cpp$(PreprocessSuffix) image_io.cpp
+
+$(IntermediateDirectory)/heatmap.cpp$(ObjectSuffix): heatmap.cpp $(IntermediateDirectory)/heatmap.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/heatmap.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/heatmap.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/heatmap.cpp$(DependSuffix): heatmap.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/heatmap.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/heatmap.cpp$(DependSuffix) -MM heatmap.cpp
+
+$(IntermediateDirectory)/heatmap.cpp$(PreprocessSuffix): heatmap.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/heatmap.cpp$(PreprocessSuffix) heatmap.cpp
+
+$(IntermediateDirectory)/bench.cpp$(ObjectSuffix): bench.cpp $(IntermediateDirectory)/bench.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/bench.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/bench.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/bench.cpp$(DependSuffix): bench.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/bench.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/bench.cpp$(DependSuffix) -MM bench.cpp
+
+$(IntermediateDirectory)/bench.cpp$(PreprocessSuffix): bench.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/bench.cpp$(PreprocessSuffix) bench.cpp
+
+$(IntermediateDirectory)/scene_bench.cpp$(ObjectSuffix): scene_bench.cpp $(IntermediateDirectory)/scene_bench.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/scene_bench.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/scene_bench.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/scene_bench.cpp$(DependSuffix): scene_bench.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/scene_bench.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/scene_bench.cpp$(DependSuffix) -MM scene_bench.cpp
+
+$(IntermediateDirectory)/scene_bench.cpp$(PreprocessSuffix): scene_bench.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/scene_bench.cpp$(PreprocessSuffix) scene_bench.cpp
+
+$(IntermediateDirectory)/converge.cpp$(ObjectSuffix): converge.cpp $(IntermediateDirectory)/converge.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/converge.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/converge.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/converge.cpp$(DependSuffix): converge.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/converge.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/converge.cpp$(DependSuffix) -MM converge.cpp
+
+$(IntermediateDirectory)/converge.cpp$(PreprocessSuffix): converge.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/converge.cpp$(PreprocessSuffix) converge.cpp
+
+$(IntermediateDirectory)/timeline.cpp$(ObjectSuffix): timeline.cpp $(IntermediateDirectory)/timeline.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/timeline.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/timeline.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/timeline.cpp$(DependSuffix): timeline.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/timeline.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/timeline.cpp$(DependSuffix) -MM timeline.cpp
+
+$(IntermediateDirectory)/timeline.cpp$(PreprocessSuffix): timeline.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/timeline.cpp$(PreprocessSuffix) timeline.cpp
+
+$(IntermediateDirectory)/memory_stats.cpp$(ObjectSuffix): memory_stats.cpp $(IntermediateDirectory)/memory_stats.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/memory_stats.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/memory_stats.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/memory_stats.cpp$(DependSuffix): memory_stats.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/memory_stats.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/memory_stats.cpp$(DependSuffix) -MM memory_stats.cpp
+
+$(IntermediateDirectory)/memory_stats.cpp$(PreprocessSuffix): memory_stats.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/memory_stats.cpp$(PreprocessSuffix) memory_stats.cpp
+
+$(IntermediateDirectory)/light_tree.cpp$(ObjectSuffix): light_tree.cpp $(IntermediateDirectory)/light_tree.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/light_tree.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/light_tree.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/light_tree.cpp$(DependSuffix): light_tree.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/light_tree.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/light_tree.cpp$(DependSuffix) -MM light_tree.cpp
+
+$(IntermediateDirectory)/light_tree.cpp$(PreprocessSuffix): light_tree.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/light_tree.cpp$(PreprocessSuffix) light_tree.cpp
+
+$(IntermediateDirectory)/alias_table.cpp$(ObjectSuffix): alias_table.cpp $(IntermediateDirectory)/alias_table.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/alias_table.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/alias_table.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/alias_table.cpp$(DependSuffix): alias_table.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/alias_table.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/alias_table.cpp$(DependSuffix) -MM alias_table.cpp
+
+$(IntermediateDirectory)/alias_table.cpp$(PreprocessSuffix): alias_table.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/alias_table.cpp$(PreprocessSuffix) alias_table.cpp
+
+$(IntermediateDirectory)/environment.cpp$(ObjectSuffix): environment.cpp $(IntermediateDirectory)/environment.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/environment.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/environment.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/environment.cpp$(DependSuffix): environment.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/environment.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/environment.cpp$(DependSuffix) -MM environment.cpp
+
+$(IntermediateDirectory)/environment.cpp$(PreprocessSuffix): environment.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/environment.cpp$(PreprocessSuffix) environment.cpp
+
+$(IntermediateDirectory)/bdpt.cpp$(ObjectSuffix): bdpt.cpp $(IntermediateDirectory)/bdpt.cpp$(DependSuffix)
+	$(CXX) $(IncludePCH) $(SourceSwitch) "C:/WorkSpace/therestofyourlife/bdpt.cpp" $(CXXFLAGS) $(ObjectSwitch)$(IntermediateDirectory)/bdpt.cpp$(ObjectSuffix) $(IncludePath)
+$(IntermediateDirectory)/bdpt.cpp$(DependSuffix): bdpt.cpp
+	@$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) -MG -MP -MT$(IntermediateDirectory)/bdpt.cpp$(ObjectSuffix) -MF$(IntermediateDirectory)/bdpt.cpp$(DependSuffix) -MM bdpt.cpp
+
+$(IntermediateDirectory)/bdpt.cpp$(PreprocessSuffix): bdpt.cpp
+	$(CXX) $(CXXFLAGS) $(IncludePCH) $(IncludePath) $(PreprocessOnlySwitch) $(OutputSwitch) $(IntermediateDirectory)/bdpt.cpp$(PreprocessSuffix) bdpt.cpp
+
 
 -include $(IntermediateDirectory)/*$(DependSuffix)
 ##
@@ -0,0 +1,111 @@
+#include "timeline.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+static std::chrono::steady_clock::time_point timeline_start;
+static std::atomic<int> next_thread(0);
+static std::mutex merged_mutex;
+static std::vector<timeline_event> merged;
+static std::vector<std::pair<int, std::string>> thread_names;
+
+struct thread_timeline
+{
+    int                         id = next_thread++;
+    bool                        named = false;
+    std::vector<timeline_event> events;
+
+    ~thread_timeline()
+    {
+        std::lock_guard<std::mutex> lock(merged_mutex);
+        merged.insert(merged.end(), events.begin(), events.end());
+    }
+};
+
+static thread_local thread_timeline tls_timeline;
+
+void enable_timeline()
+{
+    timeline_start = std::chrono::steady_clock::now();
+    timeline_enabled() = true;
+}
+
+void add_timeline_event(timeline_event &e, std::chrono::steady_clock::time_point start)
+{
+    auto end = std::chrono::steady_clock::now();
+
+    e.start = std::chrono::duration<double, std::micro>(start - timeline_start).count();
+    e.duration = std::chrono::duration<double, std::micro>(end - start).count();
+    e.thread = tls_timeline.id;
+    tls_timeline.events.push_back(e);
+}
+
+void name_timeline_thread(const char *name)
+{
+    if( !timeline_enabled() || tls_timeline.named )
+        return;
+
+    tls_timeline.named = true;
+
+    std::lock_guard<std::mutex> lock(merged_mutex);
+    thread_names.push_back(std::make_pair(tls_timeline.id, std::string(name) + " " + std::to_string(tls_timeline.id)));
+}
+
+std::string json_string(const std::string &s)
+{
+    std::string out = "\"";
+
+    for(char c : s) {
+        if( c == '"' || c == '\\' ) {
+            out += '\\';
+            out += c;
+        }
+        else if( (unsigned char)c < 0x20 ) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+            out += escaped;
+        }
+        else
+            out += c;
+    }
+
+    return out + "\"";
+}
+
+bool write_timeline(const char *path)
+{
+    std::ofstream file(path);
+
+    if( !file )
+        return false;
+
+    std::lock_guard<std::mutex> lock(merged_mutex);
+    std::vector<timeline_event> events = merged;
+    events.insert(events.end(), tls_timeline.events.begin(), tls_timeline.events.end());
+
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+
+    for(size_t i = 0; i < thread_names.size(); ++i) {
+        file << (i ? ",\n" : "") << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": " << thread_names[i].first
+             << ", \"args\": {\"name\": " << json_string(thread_names[i].second) << "}}";
+    }
+
+    for(size_t i = 0; i < events.size(); ++i) {
+        const timeline_event &e = events[i];
+
+        file << (i || !thread_names.empty() ? ",\n" : "") << "{\"ph\": \"X\", \"name\": " << json_string(e.name)
+             << ", \"cat\": " << json_string(e.category) << ", \"pid\": 1, \"tid\": " << e.thread << ", \"ts\": " << std::fixed << e.start << ", \"dur\": " << e.duration;
+        file.unsetf(std::ios::fixed);
+
+        if( !e.args.empty() )
+            file << ", \"args\": {" << e.args << "}";
+        file << "}";
+    }
+
+    file << "\n]}\n";
+
+    return bool(file);
+}
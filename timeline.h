@@ -0,0 +1,78 @@
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+
+#include <chrono>
+#include <string>
+
+// Spans of time recorded per thread, exported as Chrome trace JSON for
+// chrome://tracing or Perfetto. Off until enabled, then each scope adds a
+// complete event to its thread's buffer. Threads hand their buffers over
+// when they exit.
+void enable_timeline();
+
+inline bool &timeline_enabled()
+{
+    static bool enabled = false;
+    return enabled;
+}
+
+struct timeline_event
+{
+    std::string name,
+                category,
+                args;       // JSON members, without the braces.
+    double      start,      // Microseconds since the timeline was enabled.
+                duration;
+    int         thread;
+};
+
+void add_timeline_event(timeline_event &e, std::chrono::steady_clock::time_point start);
+
+// s as a quoted JSON string, quotes, backslashes and control characters escaped.
+std::string json_string(const std::string &s);
+
+// Names the calling thread in the viewer, the first name given sticks.
+void name_timeline_thread(const char *name);
+
+class timeline_scope
+{
+    public:
+        timeline_scope(const char *name, const char *category) : active(timeline_enabled())
+        {
+            if( active ) {
+                event.name = name;
+                event.category = category;
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~timeline_scope()
+        {
+            if( active )
+                add_timeline_event(event, start);
+        }
+
+        // Shown with the event when it is selected.
+        void arg(const char *key, long long value)
+        {
+            if( active )
+                event.args += (event.args.empty() ? "\"" : ", \"") + std::string(key) + "\": " + std::to_string(value);
+        }
+
+        void arg(const char *key, const char *value)
+        {
+            if( active )
+                event.args += (event.args.empty() ? "\"" : ", \"") + std::string(key) + "\": " + json_string(value);
+        }
+
+    private:
+        bool            active;
+        timeline_event  event;
+        std::chrono::steady_clock::time_point start;
+};
+
+// Events of the threads that exited and of the calling one. False if the
+// file could not be written.
+bool write_timeline(const char *path);
+
+#endif // __TIMELINE_H__
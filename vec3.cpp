@@ -17,6 +17,16 @@ vec3 random_in_unit_sphere()
     return p;
 }
 
+vec3 random_cosine_direction()
+{
+    float r1 = drand48();
+    float r2 = drand48();
+    float phi = 2.0 * kPI * r1;
+    float r = sqrt(r2);
+    
+    return vec3(cos(phi) * r, sin(phi) * r, sqrt(1.0 - r2));
+}
+
 vec3 reflect(const vec3 &v, const vec3 &n)
 {
     return v - 2.0 * dot(v, n) * n;
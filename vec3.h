@@ -7,6 +7,8 @@
 
 #include "rangen.h"
 
+const double kPI = 3.141592653589793;
+
 class vec3 {
     public:
         vec3() { e[0] = e[1] = e[2] = 0.0; }
@@ -162,12 +164,19 @@ inline vec3 unit_vector(vec3 v)
     return v / v.length();
 }
 
+// Of a linear RGB color, Rec. 709 weights.
+inline float luminance(const vec3 &c)
+{
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
 inline std::ostream& operator<<(std::ostream &os, const vec3 &t) {
     os << t.e[0] << " " << t.e[1] << " " << t.e[2];
     return os;
 }
 
 vec3 random_in_unit_sphere();
+vec3 random_cosine_direction();     // Around +z, with density cos(theta) / pi.
 vec3 reflect(const vec3 &v, const vec3 &n);
 bool refract(const vec3 &v, const vec3 &n, float ni_over_nt, vec3 &refracted);
 